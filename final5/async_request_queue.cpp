@@ -0,0 +1,12 @@
+#include "async_request_queue.h"
+
+std::future<std::vector<Document>> AsyncRequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    // the status overload ANDs the bitmap of the status instead of calling a predicate per candidate
+    return AddRequest([this, raw_query, status] {
+        return search_server_.FindTopDocuments(raw_query, status);
+        });
+}
+
+std::future<std::vector<Document>> AsyncRequestQueue::AddFindRequest(const std::string& raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
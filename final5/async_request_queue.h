@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+
+#include "search_server.h"
+#include "request_statistics.h"
+#include "thread_pool.h"
+
+// Runs search requests on a pool of worker threads.
+// The server must not be modified while requests are in flight.
+class AsyncRequestQueue {
+public:
+    using Backpressure = ThreadPool::Backpressure;
+
+    inline static constexpr size_t DEFAULT_QUEUE_CAPACITY = 1024;
+
+    explicit AsyncRequestQueue(const SearchServer& search_server,
+        size_t thread_count = std::thread::hardware_concurrency(),
+        size_t queue_capacity = DEFAULT_QUEUE_CAPACITY,
+        Backpressure backpressure = Backpressure::BLOCK,
+        RequestStatistics::Clock::duration qps_window = RequestStatistics::DEFAULT_QPS_WINDOW)
+        : search_server_(search_server), statistics_(qps_window), pool_(thread_count, queue_capacity, backpressure) {}
+
+    // Errors of the query are rethrown by future::get().
+    // A rejected request (REJECT policy, queue is full) returns an invalid future: valid() == false
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> AddFindRequest(const std::string&, DocumentPredicate);
+
+    std::future<std::vector<Document>> AddFindRequest(const std::string&, DocumentStatus);
+
+    std::future<std::vector<Document>> AddFindRequest(const std::string&);
+
+    inline uint64_t GetRejectedRequests() const noexcept {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+    // Latency includes the time spent in the queue
+    inline const RequestStatistics& GetStatistics() const noexcept {
+        return statistics_;
+    }
+
+private:
+    const SearchServer& search_server_;
+    RequestStatistics statistics_;
+    std::atomic<uint64_t> rejected_{ 0 };
+    // the last member: workers are joined before the rest is destroyed
+    ThreadPool pool_;
+    // Runs search() on the pool and records its statistics
+    template <typename Search>
+    std::future<std::vector<Document>> AddRequest(Search search);
+};
+
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> AsyncRequestQueue::AddFindRequest(const std::string& raw_query,
+    DocumentPredicate document_predicate) {
+    return AddRequest([this, raw_query, document_predicate] {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+        });
+}
+
+template <typename Search>
+std::future<std::vector<Document>> AsyncRequestQueue::AddRequest(Search search) {
+    using Clock = RequestStatistics::Clock;
+    const Clock::time_point start = Clock::now();
+
+    // std::function needs a copyable target, packaged_task is move-only
+    auto task = std::make_shared<std::packaged_task<std::vector<Document>()>>(
+        [this, search = std::move(search), start] {
+            std::vector<Document> result = search();
+            const Clock::time_point now = Clock::now();
+            statistics_.Record(now, now - start, result.size());
+            return result;
+        });
+    std::future<std::vector<Document>> result = task->get_future();
+
+    if (!pool_.Submit([task] { (*task)(); })) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    return result;
+}
@@ -0,0 +1,12 @@
+#include "async_search.h"
+
+Task<std::vector<Document>> FindTopDocumentsAsync(ThreadPool& executor, const SearchServer& search_server,
+    std::string raw_query, DocumentStatus status) {
+    co_await ScheduleOn(executor);
+    co_return search_server.FindTopDocuments(raw_query, status);
+}
+
+Task<std::vector<Document>> FindTopDocumentsAsync(ThreadPool& executor, const SearchServer& search_server,
+    std::string raw_query) {
+    return FindTopDocumentsAsync(executor, search_server, std::move(raw_query), DocumentStatus::ACTUAL);
+}
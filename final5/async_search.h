@@ -0,0 +1,37 @@
+#pragma once
+
+// C++20 coroutines: requires -std=c++20
+
+#include "search_server.h"
+#include "task.h"
+#include "thread_pool.h"
+
+// co_await ScheduleOn(pool) continues the coroutine on a worker of the pool.
+// If the pool rejects the task the coroutine continues on the current thread.
+inline auto ScheduleOn(ThreadPool& pool) noexcept {
+    struct Awaiter {
+        ThreadPool& pool;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        bool await_suspend(std::coroutine_handle<> handle) const {
+            return pool.Submit([handle] { handle.resume(); });
+        }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{ pool };
+}
+
+// The search runs on the executor; the awaiting coroutine is resumed there as well.
+// The server must not be modified while the task is in flight
+template <typename DocumentPredicate>
+Task<std::vector<Document>> FindTopDocumentsAsync(ThreadPool& executor, const SearchServer& search_server,
+    std::string raw_query, DocumentPredicate document_predicate) {
+    co_await ScheduleOn(executor);
+    co_return search_server.FindTopDocuments(raw_query, document_predicate);
+}
+
+Task<std::vector<Document>> FindTopDocumentsAsync(ThreadPool&, const SearchServer&, std::string, DocumentStatus);
+
+Task<std::vector<Document>> FindTopDocumentsAsync(ThreadPool&, const SearchServer&, std::string);
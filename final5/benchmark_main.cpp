@@ -0,0 +1,608 @@
+// Benchmarks of SearchServer on synthetic Zipf-distributed corpora.
+//
+//     search_server_benchmark [--preset quick|full] [--docs 10000[,100000...]] [--queries 200] [--dedup-limit 250]
+//         [--fuzzy-terms 1000000] [--format json|text]
+//
+// The defaults are the quick preset: 10000 documents and a dictionary of 1000000 words for the fuzzy expansion.
+// The full preset sweeps 10000, 100000 and 1000000 documents and expands over 10000000 words.
+// Flags after --preset override it. Build with the benchmark build preset: cmake --build --preset benchmark
+//
+// The corpora run one after the other, so the largest one sets the peak memory. On one core of a
+// Release build, 100000 documents take about 2.5 minutes and 570 MB; 1000000 documents need about
+// ten times that, 6 GB or more. The fuzzy expansion over 10000000 words needs about 2.3 GB.
+//
+// Every measurement is printed as one line: a JSON object (default) or human readable text.
+// AddDocument and the removal of the whole corpus are measured for both IndexAllocation modes,
+// and Clear of a pooled index.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <set>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+#include "external_index.h"
+#include "remove_duplicates.h"
+#include "request_statistics.h"
+#include "search_cursor.h"
+#include "search_server.h"
+#include "stop_word_filter.h"
+#include "tokenizer.h"
+#include "zipf_corpus.h"
+
+// Every call of operator new in the process is counted,
+// the aligned one included: std::pmr::new_delete_resource uses it
+static std::atomic<uint64_t> allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a non-zero multiple of the alignment
+    const size_t rounded = (size == 0 ? 1 : size + align - 1) / align * align;
+    if (void* pointer = std::aligned_alloc(align, rounded == 0 ? align : rounded)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+// kept out of line and the only caller of free: inlined into a delete expression,
+// GCC reports free as mismatched with operator new
+[[gnu::noinline]] void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    ::operator delete(pointer);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// the defaults are the quick preset
+struct BenchmarkOptions {
+    std::vector<size_t> document_counts = { 10000 };
+    size_t query_count = 200;
+    // RemoveDuplicates compares every pair of documents with the forward index, larger corpora skip that;
+    // its signature path runs at every size
+    size_t dedup_limit = 250;
+    // indexed words for the fuzzy expansion benchmark, 0 skips it
+    size_t fuzzy_terms = 1000000;
+    bool json = true;
+};
+
+struct Result {
+    std::string name;
+    size_t documents = 0;
+    uint64_t operations = 0;
+    double seconds = 0.0;
+    const LatencyHistogram* latency = nullptr;
+    uint64_t allocations = 0;
+    // heap allocations made by the index containers, if measured
+    const uint64_t* index_allocations = nullptr;
+};
+
+// peak resident set size of the process in kilobytes, 0 if unknown
+long GetPeakRssKb() {
+#ifdef __unix__
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+void Print(const Result& result, const BenchmarkOptions& options) {
+    const double ops_per_second = result.seconds > 0.0 ? result.operations / result.seconds : 0.0;
+    if (options.json) {
+        std::cout << "{\"benchmark\": \"" << result.name << "\", \"documents\": " << result.documents
+            << ", \"operations\": " << result.operations
+            << ", \"seconds\": " << result.seconds
+            << ", \"ops_per_second\": " << ops_per_second
+            << ", \"allocations\": " << result.allocations;
+        if (result.index_allocations != nullptr) {
+            std::cout << ", \"index_allocations\": " << *result.index_allocations;
+        }
+        if (result.latency != nullptr) {
+            std::cout << ", \"mean_ns\": " << static_cast<uint64_t>(result.latency->GetMean())
+                << ", \"p50_ns\": " << result.latency->GetValueAtQuantile(0.5)
+                << ", \"p99_ns\": " << result.latency->GetValueAtQuantile(0.99)
+                << ", \"max_ns\": " << result.latency->GetMax();
+        }
+        std::cout << ", \"peak_rss_kb\": " << GetPeakRssKb() << "}" << "\n";
+    }
+    else {
+        std::cout << result.name << " [" << result.documents << " docs]: " << result.operations << " ops in "
+            << result.seconds << " s (" << ops_per_second << " ops/s), " << result.allocations << " allocations";
+        if (result.index_allocations != nullptr) {
+            std::cout << " (" << *result.index_allocations << " by the index)";
+        }
+        if (result.latency != nullptr) {
+            std::cout << ", mean " << static_cast<uint64_t>(result.latency->GetMean()) << " ns"
+                << ", p50 " << result.latency->GetValueAtQuantile(0.5) << " ns"
+                << ", p99 " << result.latency->GetValueAtQuantile(0.99) << " ns";
+        }
+        std::cout << ", peak RSS " << GetPeakRssKb() << " KB" << "\n";
+    }
+}
+
+// The memory of an index by part, one line as Print
+void PrintMemoryStats(const std::string& name, size_t documents, const IndexMemoryStats& stats, const BenchmarkOptions& options) {
+    if (options.json) {
+        std::cout << "{\"benchmark\": \"" << name << "\", \"documents\": " << documents
+            << ", \"term_dictionary_bytes\": " << stats.term_dictionary
+            << ", \"postings_bytes\": " << stats.postings
+            << ", \"forward_index_bytes\": " << stats.forward_index
+            << ", \"document_metadata_bytes\": " << stats.document_metadata
+            << ", \"stop_words_bytes\": " << stats.stop_words
+            << ", \"total_bytes\": " << stats.total
+            << ", \"heap_bytes\": " << stats.heap
+            << ", \"bytes_per_document\": " << stats.per_document << "}" << "\n";
+    }
+    else {
+        std::cout << name << " [" << documents << " docs]: " << stats.total << " bytes ("
+            << stats.term_dictionary << " dictionary, " << stats.postings << " postings, "
+            << stats.forward_index << " forward index, " << stats.document_metadata << " documents, "
+            << stats.stop_words << " stop words), " << stats.heap << " bytes of heap, "
+            << stats.per_document << " bytes per document" << "\n";
+    }
+}
+
+// Runs operation(i) for i in [0, count) and records the latency of every call
+void MeasureLatency(const std::string& name, size_t documents, size_t count,
+    const std::function<void(size_t)>& operation, const BenchmarkOptions& options,
+    const IndexMemory* index_memory = nullptr) {
+    LatencyHistogram latency;
+    const uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+    const uint64_t index_allocations_before = index_memory != nullptr ? index_memory->GetHeap().GetAllocations() : 0;
+    const Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const Clock::time_point start = Clock::now();
+        operation(i);
+        latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    const uint64_t index_allocations =
+        index_memory != nullptr ? index_memory->GetHeap().GetAllocations() - index_allocations_before : 0;
+    Print({ name, documents, count, seconds, &latency, allocation_count.load(std::memory_order_relaxed) - allocations,
+        index_memory != nullptr ? &index_allocations : nullptr }, options);
+}
+
+// Builds and drops a whole index with the nodes served from pools
+void RunPoolIngestion(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    SearchServer search_server(corpus.stop_words, IndexAllocation::POOL);
+
+    MeasureLatency("AddDocument/pool", document_count, document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }, options, &search_server.GetIndexMemory());
+    PrintMemoryStats("MemoryStats/pool", document_count, search_server.MemoryStats(), options);
+
+    // the oldest document gives way to a new one, over the corpus four times:
+    // the heap of MemoryStats/pool_churn stays near that of MemoryStats/pool
+    const size_t churn_passes = 4;
+    MeasureLatency("RemoveDocument+AddDocument/pool_churn", document_count, document_count * churn_passes, [&](size_t i) {
+        search_server.RemoveDocument(static_cast<int>(i));
+        const size_t source = i % document_count;
+        search_server.AddDocument(static_cast<int>(document_count + i), corpus.documents[source], DocumentStatus::ACTUAL,
+            corpus.ratings[source]);
+        }, options, &search_server.GetIndexMemory());
+    PrintMemoryStats("MemoryStats/pool_churn", document_count, search_server.MemoryStats(), options);
+
+    MeasureLatency("RemoveDocument/pool_all", document_count, document_count, [&](size_t i) {
+        search_server.RemoveDocument(static_cast<int>(document_count * churn_passes + i));
+        }, options);
+
+    // the corpus again, dropped as one segment
+    for (size_t i = 0; i < document_count; ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+    }
+    MeasureLatency("Clear/pool", document_count, 1, [&](size_t) {
+        search_server.Clear();
+        }, options);
+}
+
+// Builds an index without the forward index, as a node that only answers queries would
+void RunQueryOnlyIngestion(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    SearchServer search_server(corpus.stop_words, IndexAllocation::HEAP, ForwardIndex::NONE);
+
+    MeasureLatency("AddDocument/no_forward_index", document_count, document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }, options, &search_server.GetIndexMemory());
+    PrintMemoryStats("MemoryStats/no_forward_index", document_count, search_server.MemoryStats(), options);
+    // every removal searches the whole dictionary, so only a few are timed
+    const size_t removals = std::min<size_t>(document_count, 100);
+    MeasureLatency("RemoveDocument/no_forward_index", document_count, removals, [&](size_t i) {
+        search_server.RemoveDocument(static_cast<int>(i));
+        }, options);
+}
+
+// Ingestion checking every document against the signatures, then copies of the first documents, all rejected
+void RunIngestDeduplication(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    SearchServer search_server(corpus.stop_words);
+    search_server.SetDeduplication(Deduplication::REJECT);
+
+    MeasureLatency("AddDocument/dedup", document_count, document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }, options, &search_server.GetIndexMemory());
+    const size_t copies = std::min<size_t>(document_count, 1000);
+    MeasureLatency("AddDocument/dedup_rejected", document_count, copies, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(document_count + i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }, options);
+    PrintMemoryStats("MemoryStats/dedup", document_count, search_server.MemoryStats(), options);
+
+    // signing an index built without deduplication
+    search_server.SetDeduplication(Deduplication::OFF);
+    MeasureLatency("SetDeduplication", document_count, 1, [&](size_t) {
+        search_server.SetDeduplication(Deduplication::RECORD);
+        }, options);
+}
+
+// The corpus spread over shards and deduplicated across them, with one worker and with one per shard
+void RunShardDeduplication(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    const size_t shard_count = 4;
+    for (const size_t thread_count : { size_t{ 1 }, shard_count }) {
+        std::vector<SearchServer> shards;
+        for (size_t shard = 0; shard < shard_count; ++shard) {
+            shards.emplace_back(corpus.stop_words);
+        }
+        for (size_t i = 0; i < document_count; ++i) {
+            shards[i % shard_count].AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }
+        ThreadPool pool(thread_count, shard_count);
+        MeasureLatency("RemoveDuplicates/shards_" + std::to_string(shard_count) + "_threads_" + std::to_string(thread_count),
+            document_count, 1, [&](size_t) {
+                RemoveDuplicates(pool, shards);
+            }, options);
+    }
+}
+
+// Splitting of every document with and without SIMD, the views kept in the query arena
+void RunTokenizer(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    volatile size_t sink = 0;
+    for (const bool use_simd : { true, false }) {
+        const Tokenizer tokenizer(TokenizerOptions{ " ", false, use_simd });
+        QueryArena& arena = QueryArena::ForThisThread();
+        MeasureLatency(use_simd ? "Tokenizer/simd" : "Tokenizer/scalar", document_count, document_count, [&](size_t i) {
+            QueryArena::Scope arena_scope(arena);
+            std::pmr::vector<std::string_view> words(&arena);
+            if (tokenizer.Split(corpus.documents[i], words, &arena)) {
+                sink = sink + words.size();
+            }
+            }, options);
+    }
+}
+
+// Stop word lookups of every word of the documents, in a std::set and in the perfect hash
+void RunStopWords(const Corpus& corpus, size_t document_count, const BenchmarkOptions& options) {
+    const Tokenizer tokenizer;
+    std::vector<std::pmr::vector<std::string_view>> document_words;
+    document_words.reserve(document_count);
+    for (size_t i = 0; i < document_count; ++i) {
+        std::pmr::vector<std::string_view>& words = document_words.emplace_back();
+        if (!tokenizer.Split(corpus.documents[i], words, std::pmr::get_default_resource())) {
+            throw std::invalid_argument("control character in document " + std::to_string(i));
+        }
+    }
+    volatile size_t sink = 0;
+    for (const size_t stop_word_count : { 100, 250, 500 }) {
+        const auto stop_words_end = corpus.vocabulary.begin() + std::min(stop_word_count, corpus.vocabulary.size());
+        const std::set<std::string, std::less<>> stop_word_set(corpus.vocabulary.begin(), stop_words_end);
+        const StopWordFilter stop_word_filter = StopWordFilter::Of(stop_word_set);
+        const std::string suffix = "/" + std::to_string(stop_word_count);
+
+        MeasureLatency("StopWords/set" + suffix, document_count, document_count, [&](size_t i) {
+            for (const std::string_view word : document_words[i]) {
+                sink = sink + stop_word_set.count(word);
+            }
+            }, options);
+        MeasureLatency("StopWords/perfect_hash" + suffix, document_count, document_count, [&](size_t i) {
+            for (const std::string_view word : document_words[i]) {
+                sink = sink + stop_word_filter.Contains(word);
+            }
+            }, options);
+    }
+}
+
+// Record of one latency into a histogram shared by the threads, which must stay under 50 ns
+void RunLatencyHistogram(const BenchmarkOptions& options) {
+    constexpr size_t RECORDS_PER_THREAD = 10'000'000;
+    for (const size_t thread_count : { size_t{ 1 }, size_t{ 4 } }) {
+        LatencyHistogram histogram;
+        const uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+        const Clock::time_point begin = Clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&histogram, t] {
+                // latencies from 1 us to ~1 ms, spread over the buckets
+                uint64_t value = 1000 + t;
+                for (size_t i = 0; i < RECORDS_PER_THREAD; ++i) {
+                    histogram.Record(value);
+                    value = value * 6364136223846793005u + 1442695040888963407u;
+                    value = 1000 + (value >> 44);
+                }
+                });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        Print({ "LatencyHistogram/Record_threads_" + std::to_string(thread_count), 0, RECORDS_PER_THREAD * thread_count,
+            seconds, nullptr, allocation_count.load(std::memory_order_relaxed) - allocations }, options);
+    }
+}
+
+// Expansion of fuzzy words with one typo over a large dictionary, without the search
+void RunFuzzyExpansion(const BenchmarkOptions& options) {
+    std::mt19937_64 generator(17);
+    const std::vector<std::string> vocabulary = GenerateVocabulary(options.fuzzy_terms, generator);
+
+    // a thousand words per document keeps the index small next to the dictionary,
+    // and without the forward index 10000000 words fit in a few gigabytes
+    constexpr size_t WORDS_PER_DOCUMENT = 1000;
+    SearchServer search_server(""s, IndexAllocation::HEAP, ForwardIndex::NONE);
+    search_server.SetQuerySyntax({ .fuzzy = true });
+    std::string document;
+    for (size_t i = 0; i < vocabulary.size(); i += WORDS_PER_DOCUMENT) {
+        document.clear();
+        for (size_t j = i; j < std::min(vocabulary.size(), i + WORDS_PER_DOCUMENT); ++j) {
+            document += vocabulary[j];
+            document += ' ';
+        }
+        search_server.AddDocument(static_cast<int>(i / WORDS_PER_DOCUMENT), document, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> typos;
+    for (size_t i = 0; i < options.query_count; ++i) {
+        std::string word = vocabulary[generator() % vocabulary.size()];
+        word[generator() % word.size()] = static_cast<char>(letter(generator));
+        typos.push_back(std::move(word));
+    }
+    volatile size_t sink = 0;
+    for (const char* const distance : { "1", "2" }) {
+        const std::string name = "FuzzyExpansion/distance_"s + distance + "/" + std::to_string(vocabulary.size()) + "_terms";
+        MeasureLatency(name, search_server.GetDocumentCount(), typos.size(), [&](size_t i) {
+            sink = sink + search_server.GetQueryKey(typos[i] + "~" + distance).size();
+            }, options);
+    }
+}
+
+// An index file built through runs of a few megabytes, then queried in place
+void RunExternalIndex(const Corpus& corpus, const CorpusOptions& corpus_options, size_t document_count,
+    const BenchmarkOptions& options) {
+    const std::filesystem::path index_path = std::filesystem::temp_directory_path() / "search_server_benchmark.idx";
+    {
+        ExternalIndexOptions index_options;
+        index_options.memory_budget = 4 << 20;
+        ExternalIndexBuilder builder(index_path, "", index_options);
+        MeasureLatency("ExternalIndex/add", document_count, document_count, [&](size_t i) {
+            builder.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+            }, options);
+        MeasureLatency("ExternalIndex/finish", document_count, 1, [&](size_t) {
+            builder.Finish();
+            }, options);
+    }
+    const ExternalIndex index(index_path);
+    const std::vector<std::string> queries = GenerateQueries(corpus, corpus_options, options.query_count, 10, 0, 7);
+    volatile size_t sink = 0;
+    MeasureLatency("ExternalIndex/FindTopDocuments_long", document_count, queries.size(), [&](size_t i) {
+        sink = sink + index.FindTopDocuments(queries[i]).size();
+        }, options);
+    std::filesystem::remove(index_path);
+}
+
+// One call of RemoveDuplicates after prepare(), both timed; the ids it prints are discarded
+void MeasureRemoveDuplicates(const std::string& name, SearchServer& search_server, const BenchmarkOptions& options,
+    const std::function<void()>& prepare = [] {}) {
+    const size_t document_count = static_cast<size_t>(search_server.GetDocumentCount());
+    std::ostringstream discarded;
+    MeasureLatency(name, document_count, 1, [&](size_t) {
+        prepare();
+        std::streambuf* const cout_buffer = std::cout.rdbuf(discarded.rdbuf());
+        RemoveDuplicates(search_server);
+        std::cout.rdbuf(cout_buffer);
+        }, options);
+}
+
+void RunCorpus(size_t document_count, const BenchmarkOptions& options) {
+    CorpusOptions corpus_options;
+    corpus_options.document_count = document_count;
+    const Corpus corpus = GenerateCorpus(corpus_options);
+
+    RunTokenizer(corpus, document_count, options);
+    RunStopWords(corpus, document_count, options);
+    RunPoolIngestion(corpus, document_count, options);
+    RunQueryOnlyIngestion(corpus, document_count, options);
+    RunIngestDeduplication(corpus, document_count, options);
+    RunShardDeduplication(corpus, document_count, options);
+    RunExternalIndex(corpus, corpus_options, document_count, options);
+
+    SearchServer search_server(corpus.stop_words);
+
+    MeasureLatency("AddDocument", document_count, document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }, options, &search_server.GetIndexMemory());
+    PrintMemoryStats("MemoryStats", document_count, search_server.MemoryStats(), options);
+
+    struct QueryKind {
+        std::string name;
+        size_t plus_words;
+        size_t minus_words;
+    };
+    const std::vector<QueryKind> kinds = {
+        { "FindTopDocuments/short", 2, 0 },
+        { "FindTopDocuments/long", 10, 0 },
+        { "FindTopDocuments/minus_heavy", 3, 6 },
+    };
+    // volatile sink keeps the results alive
+    volatile size_t sink = 0;
+    for (const QueryKind& kind : kinds) {
+        const std::vector<std::string> queries =
+            GenerateQueries(corpus, corpus_options, options.query_count, kind.plus_words, kind.minus_words, 7);
+        MeasureLatency(kind.name, document_count, queries.size(), [&](size_t i) {
+            sink = sink + search_server.FindTopDocuments(queries[i]).size();
+            }, options);
+    }
+
+    const std::vector<std::string> bm25_queries =
+        GenerateQueries(corpus, corpus_options, options.query_count, 10, 0, 7);
+    MeasureLatency("FindTopDocuments/long_bm25", document_count, bm25_queries.size(), [&](size_t i) {
+        sink = sink + search_server.FindTopDocuments<Bm25>(bm25_queries[i]).size();
+        }, options);
+
+    MeasureLatency("FindTopDocuments/rating_range", document_count, bm25_queries.size(), [&](size_t i) {
+        sink = sink + search_server.FindTopDocuments(bm25_queries[i], DocumentStatus::ACTUAL, { 8, 10 }).size();
+        }, options);
+
+    // three letter prefixes of frequent words, each expanded to many indexed words
+    std::vector<std::string> prefix_queries;
+    for (size_t i = 0; i < options.query_count; ++i) {
+        prefix_queries.push_back(corpus.vocabulary[(i * 7) % std::min<size_t>(corpus.vocabulary.size(), 1000)].substr(0, 3) + "*");
+    }
+    search_server.SetQuerySyntax({ .patterns = true });
+    MeasureLatency("FindTopDocuments/prefix", document_count, prefix_queries.size(), [&](size_t i) {
+        sink = sink + search_server.FindTopDocuments(prefix_queries[i]).size();
+        }, options);
+    search_server.SetQuerySyntax({});
+
+    // every match of a few short queries, a thousand at a time
+    const std::vector<std::string> export_queries =
+        GenerateQueries(corpus, corpus_options, 5, 2, 0, 13);
+    // the query is scored by the first chunk only, the others take from its scores
+    for (const size_t chunk_size : { 1000, 100, 10 }) {
+        MeasureLatency("SearchCursor/export_" + std::to_string(chunk_size), document_count, export_queries.size(), [&](size_t i) {
+            SearchCursor cursor(search_server, export_queries[i], chunk_size);
+            for (std::vector<Document> chunk = cursor.Next(); !chunk.empty(); chunk = cursor.Next()) {
+                sink = sink + chunk.size();
+            }
+            }, options);
+    }
+
+    const std::vector<std::string> match_queries =
+        GenerateQueries(corpus, corpus_options, options.query_count, 5, 1, 11);
+    MeasureLatency("MatchDocument", document_count, match_queries.size(), [&](size_t i) {
+        const auto [words, status] = search_server.MatchDocument(match_queries[i], static_cast<int>(i % document_count));
+        sink = sink + words.size();
+        }, options);
+
+    // pairwise with the forward index, under the limit, then by the signatures at every size
+    if (document_count <= options.dedup_limit) {
+        MeasureRemoveDuplicates("RemoveDuplicates/pairwise", search_server, options);
+    }
+    MeasureRemoveDuplicates("RemoveDuplicates/signatures", search_server, options, [&search_server] {
+        search_server.SetDeduplication(Deduplication::RECORD);
+        });
+    search_server.SetDeduplication(Deduplication::OFF);
+
+    // every 100th document, the survivors of RemoveDuplicates only
+    std::vector<int> to_remove;
+    for (const int document_id : search_server) {
+        if (document_id % 100 == 0) {
+            to_remove.push_back(document_id);
+        }
+    }
+    MeasureLatency("RemoveDocument", document_count, to_remove.size(), [&](size_t i) {
+        search_server.RemoveDocument(to_remove[i]);
+        }, options);
+
+    MeasureLatency("RemoveDocument/heap_all", document_count, document_count, [&](size_t i) {
+        search_server.RemoveDocument(static_cast<int>(i));
+        }, options);
+}
+
+// False if the preset is unknown
+bool ApplyPreset(const std::string& preset, BenchmarkOptions& options) {
+    if (preset == "quick") {
+        options.document_counts = BenchmarkOptions().document_counts;
+        options.fuzzy_terms = BenchmarkOptions().fuzzy_terms;
+        return true;
+    }
+    if (preset == "full") {
+        options.document_counts = { 10000, 100000, 1000000 };
+        options.fuzzy_terms = 10000000;
+        return true;
+    }
+    return false;
+}
+
+std::vector<size_t> ParseSizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    std::istringstream is(text);
+    std::string item;
+    while (std::getline(is, item, ',')) {
+        sizes.push_back(std::stoul(item));
+    }
+    return sizes;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--preset" && has_value && ApplyPreset(argv[i + 1], options)) {
+            ++i;
+        }
+        else if (arg == "--docs" && has_value) {
+            options.document_counts = ParseSizes(argv[++i]);
+        }
+        else if (arg == "--queries" && has_value) {
+            options.query_count = std::stoul(argv[++i]);
+        }
+        else if (arg == "--dedup-limit" && has_value) {
+            options.dedup_limit = std::stoul(argv[++i]);
+        }
+        else if (arg == "--fuzzy-terms" && has_value) {
+            options.fuzzy_terms = std::stoul(argv[++i]);
+        }
+        else if (arg == "--format" && has_value) {
+            options.json = std::string(argv[++i]) != "text";
+        }
+        else {
+            std::cerr << "usage: " << argv[0]
+                << " [--preset quick|full] [--docs N[,N...]] [--queries N] [--dedup-limit N] [--fuzzy-terms N]"
+                << " [--format json|text]" << "\n";
+            return 1;
+        }
+    }
+
+    for (const size_t document_count : options.document_counts) {
+        RunCorpus(document_count, options);
+    }
+    if (options.fuzzy_terms > 0) {
+        RunFuzzyExpansion(options);
+    }
+    RunLatencyHistogram(options);
+    return 0;
+}
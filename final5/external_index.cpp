@@ -0,0 +1,597 @@
+#include "external_index.h"
+
+#include <cstring>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+// estimated memory of a buffered word and of a posting, the nodes of the map included
+constexpr size_t WORD_OVERHEAD = 96;
+constexpr size_t POSTING_SIZE = sizeof(std::pair<int, double>);
+// postings of a term held by Finish: the ids before they go to the index file, the term frequencies
+// before they go to a temporary file
+constexpr size_t TERM_FREQS_BUFFER = 1 << 16;
+
+template <typename T>
+void WriteValue(std::ostream& output, const T& value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadValue(std::istream& input, T& value) {
+    return static_cast<bool>(input.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void WritePadding(std::ostream& output, uint64_t offset) {
+    static const char zeros[8] = {};
+    output.write(zeros, static_cast<std::streamsize>(index_file::AlignUp(offset) - offset));
+}
+
+// A run is a sequence of terms sorted by word: uint32_t word length, the word, uint32_t posting count,
+// then (int32_t id, double term frequency) pairs sorted by id. Read a posting at a time
+class RunReader {
+public:
+    explicit RunReader(const std::filesystem::path& path) : input_(path, std::ios::binary) {
+        if (!input_) {
+            throw std::runtime_error("cannot open run "s + path.string());
+        }
+    }
+
+    // Moves to the next posting, of the next term after the last one; false at the end of the run
+    bool Next() {
+        is_term_start_ = remaining_ == 0;
+        if (remaining_ == 0) {
+            uint32_t word_length = 0;
+            if (!ReadValue(input_, word_length)) {
+                return false;
+            }
+            word_.resize(word_length);
+            if (!input_.read(word_.data(), word_length) || !ReadValue(input_, remaining_) || remaining_ == 0) {
+                throw std::runtime_error("truncated run"s);
+            }
+        }
+        if (!ReadValue(input_, document_id_) || !ReadValue(input_, term_freq_)) {
+            throw std::runtime_error("truncated run"s);
+        }
+        --remaining_;
+        return true;
+    }
+
+    const std::string& GetWord() const noexcept {
+        return word_;
+    }
+
+    // The posting is the first one of its term
+    bool IsTermStart() const noexcept {
+        return is_term_start_;
+    }
+
+    int32_t GetDocumentId() const noexcept {
+        return document_id_;
+    }
+
+    double GetTermFreq() const noexcept {
+        return term_freq_;
+    }
+
+private:
+    std::ifstream input_;
+    std::string word_;
+    // postings of the word after the current one
+    uint32_t remaining_ = 0;
+    bool is_term_start_ = false;
+    int32_t document_id_ = 0;
+    double term_freq_ = 0.0;
+};
+
+// Appends the first size bytes of the input to the output
+void CopyBytes(std::istream& input, std::ostream& output, uint64_t size) {
+    char buffer[1 << 16];
+    input.seekg(0);
+    while (size > 0) {
+        const std::streamsize count = static_cast<std::streamsize>(std::min<uint64_t>(size, sizeof(buffer)));
+        if (!input.read(buffer, count)) {
+            throw std::runtime_error("cannot read a temporary file of the index"s);
+        }
+        output.write(buffer, count);
+        size -= static_cast<uint64_t>(count);
+    }
+}
+
+std::fstream OpenTemporary(const std::filesystem::path& path) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("cannot create "s + path.string());
+    }
+    return file;
+}
+
+} // namespace
+
+ExternalIndexBuilder::ExternalIndexBuilder(std::filesystem::path index_path, const std::string& stop_words,
+    ExternalIndexOptions options)
+    : index_path_(std::move(index_path)), options_(std::move(options)), tokenizer_(options_.tokenizer) {
+    if (options_.run_directory.empty()) {
+        options_.run_directory = index_path_.has_parent_path() ? index_path_.parent_path() : std::filesystem::path(".");
+    }
+
+    // the folded copy of the text lives until the filter is built
+    std::pmr::monotonic_buffer_resource resource;
+    std::pmr::vector<std::string_view> words(&resource);
+    if (!tokenizer_.Split(stop_words, words, &resource)) {
+        throw std::invalid_argument("invalid stop-words in constructor"s);
+    }
+    stop_words_ = StopWordFilter(std::vector<std::string_view>(words.begin(), words.end()));
+
+    documents_path_ = MakeTemporaryPath(".documents");
+    documents_.open(documents_path_, std::ios::binary | std::ios::trunc);
+    if (!documents_) {
+        throw std::runtime_error("cannot create "s + documents_path_.string());
+    }
+}
+
+ExternalIndexBuilder::~ExternalIndexBuilder() {
+    RemoveTemporaryFiles();
+}
+
+void ExternalIndexBuilder::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+    if (is_finished_) {
+        throw std::logic_error("the index is finished"s);
+    }
+    if (document_id < 0) {
+        throw std::invalid_argument("ID can't be less than zero"s);
+    }
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    std::pmr::vector<std::string_view> words(&arena);
+    if (!tokenizer_.Split(document, words, &arena)) {
+        throw std::invalid_argument("invalid character(s) in word"s);
+    }
+    words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) {
+        return stop_words_.Contains(word);
+        }), words.end());
+
+    // summed as SearchServer sums them, so that both give the same relevance
+    const double inv_word_count = 1.0 / words.size();
+    std::pmr::map<std::string_view, double> word_freqs(&arena);
+    for (const std::string_view word : words) {
+        word_freqs[word] += inv_word_count;
+    }
+    for (const auto& [word, term_freq] : word_freqs) {
+        auto it = postings_.find(word);
+        if (it == postings_.end()) {
+            it = postings_.emplace(std::string(word), RunPostings()).first;
+            buffered_bytes_ += WORD_OVERHEAD + word.size();
+        }
+        it->second.emplace_back(document_id, term_freq);
+        buffered_bytes_ += POSTING_SIZE;
+    }
+
+    int rating = 0;
+    if (!ratings.empty()) {
+        int rating_sum = 0;
+        for (const int value : ratings) {
+            rating_sum += value;
+        }
+        rating = rating_sum / static_cast<int>(ratings.size());
+    }
+    WriteValue(documents_, index_file::DocumentRecord{ document_id, rating, static_cast<int32_t>(status),
+        static_cast<uint32_t>(words.size()) });
+    ++document_count_;
+    total_length_ += words.size();
+
+    if (buffered_bytes_ >= options_.memory_budget) {
+        SpillRun();
+    }
+}
+
+void ExternalIndexBuilder::Finish() {
+    if (is_finished_) {
+        throw std::logic_error("the index is finished"s);
+    }
+    is_finished_ = true;
+    if (!postings_.empty()) {
+        SpillRun();
+    }
+    documents_.close();
+    if (!documents_) {
+        throw std::runtime_error("cannot write "s + documents_path_.string());
+    }
+
+    std::ofstream output(index_path_, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("cannot create "s + index_path_.string());
+    }
+    index_file::Header header{};
+    std::memcpy(header.magic, index_file::MAGIC, sizeof(header.magic));
+    header.document_count = document_count_;
+    header.total_length = total_length_;
+    header.documents_offset = sizeof(index_file::Header);
+    WriteValue(output, header);
+    WriteDocuments(output);
+    uint64_t offset = header.documents_offset + document_count_ * sizeof(index_file::DocumentRecord);
+    WritePadding(output, offset);
+    offset = index_file::AlignUp(offset);
+
+    // k-way merge by (word, id): every posting goes straight to the file. The ids of a term go first,
+    // its term frequencies wait in a buffer, spilled to a file of their own past TERM_FREQS_BUFFER;
+    // the terms and their words are written in order to two more files, appended at the end
+    std::vector<int32_t> document_id_buffer;
+    document_id_buffer.reserve(TERM_FREQS_BUFFER);
+    std::vector<double> term_freq_buffer;
+    term_freq_buffer.reserve(TERM_FREQS_BUFFER);
+    uint32_t spilled_term_freqs = 0;
+    std::fstream term_freqs = OpenTemporary(AddMergeFile(".freqs"));
+    std::fstream terms = OpenTemporary(AddMergeFile(".terms"));
+    std::fstream strings = OpenTemporary(AddMergeFile(".strings"));
+
+    std::vector<RunReader> readers;
+    readers.reserve(runs_.size());
+    const auto ranks_after = [&readers](size_t lhs, size_t rhs) {
+        const int order = readers[lhs].GetWord().compare(readers[rhs].GetWord());
+        return order != 0 ? order > 0 : readers[lhs].GetDocumentId() > readers[rhs].GetDocumentId();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(ranks_after)> heads(ranks_after);
+    for (const std::filesystem::path& run : runs_) {
+        readers.emplace_back(run);
+        if (readers.back().Next()) {
+            heads.push(readers.size() - 1);
+        }
+    }
+
+    std::string word;
+    uint32_t document_freq = 0;
+    uint64_t postings_offset = offset;
+    uint64_t strings_size = 0;
+    const auto write_document_ids = [&] {
+        output.write(reinterpret_cast<const char*>(document_id_buffer.data()),
+            static_cast<std::streamsize>(document_id_buffer.size() * sizeof(int32_t)));
+        document_id_buffer.clear();
+    };
+    const auto finish_term = [&] {
+        write_document_ids();
+        offset += uint64_t{ document_freq } * sizeof(int32_t);
+        WritePadding(output, offset);
+        offset = index_file::AlignUp(offset);
+        if (spilled_term_freqs > 0) {
+            term_freqs.flush();
+            CopyBytes(term_freqs, output, uint64_t{ spilled_term_freqs } * sizeof(double));
+            spilled_term_freqs = 0;
+        }
+        output.write(reinterpret_cast<const char*>(term_freq_buffer.data()),
+            static_cast<std::streamsize>(term_freq_buffer.size() * sizeof(double)));
+        term_freq_buffer.clear();
+        offset += uint64_t{ document_freq } * sizeof(double);
+
+        WriteValue(terms, index_file::TermRecord{ strings_size, static_cast<uint32_t>(word.size()), document_freq, postings_offset });
+        strings.write(word.data(), static_cast<std::streamsize>(word.size()));
+        strings_size += word.size();
+        ++header.term_count;
+    };
+    while (!heads.empty()) {
+        const size_t run = heads.top();
+        heads.pop();
+        // the run goes on while it is ahead of the others, ids of a run are mostly close to each other
+        RunReader& reader = readers[run];
+        bool has_next = true;
+        // the word is compared only where it may change
+        bool is_term_start = true;
+        while (has_next) {
+            if (is_term_start && document_freq > 0 && reader.GetWord() != word) {
+                finish_term();
+                document_freq = 0;
+            }
+            if (document_freq == 0) {
+                word = reader.GetWord();
+                postings_offset = offset;
+            }
+            if (document_id_buffer.size() == TERM_FREQS_BUFFER) {
+                write_document_ids();
+            }
+            document_id_buffer.push_back(reader.GetDocumentId());
+            if (term_freq_buffer.size() == TERM_FREQS_BUFFER) {
+                if (spilled_term_freqs == 0) {
+                    term_freqs.seekp(0);
+                }
+                term_freqs.write(reinterpret_cast<const char*>(term_freq_buffer.data()),
+                    static_cast<std::streamsize>(term_freq_buffer.size() * sizeof(double)));
+                spilled_term_freqs += static_cast<uint32_t>(term_freq_buffer.size());
+                term_freq_buffer.clear();
+            }
+            term_freq_buffer.push_back(reader.GetTermFreq());
+            ++document_freq;
+
+            has_next = reader.Next();
+            is_term_start = reader.IsTermStart();
+            if (has_next && !heads.empty() && ranks_after(run, heads.top())) {
+                heads.push(run);
+                break;
+            }
+        }
+    }
+    if (document_freq > 0) {
+        finish_term();
+    }
+    readers.clear();
+
+    header.terms_offset = offset;
+    terms.flush();
+    CopyBytes(terms, output, header.term_count * sizeof(index_file::TermRecord));
+    header.strings_offset = offset + header.term_count * sizeof(index_file::TermRecord);
+    strings.flush();
+    CopyBytes(strings, output, strings_size);
+    header.file_size = header.strings_offset + strings_size;
+    output.seekp(0);
+    WriteValue(output, header);
+    output.close();
+    if (!output || !term_freqs || !terms || !strings) {
+        throw std::runtime_error("cannot write "s + index_path_.string());
+    }
+    RemoveTemporaryFiles();
+}
+
+void ExternalIndexBuilder::WriteDocuments(std::ostream& output) {
+    using index_file::DocumentRecord;
+    const auto by_id = [](const DocumentRecord& lhs, const DocumentRecord& rhs) {
+        return lhs.id < rhs.id;
+    };
+
+    // runs of the budget sorted by id
+    std::ifstream input(documents_path_, std::ios::binary);
+    std::vector<DocumentRecord> records(std::min<uint64_t>(document_count_,
+        std::max<size_t>(options_.memory_budget / sizeof(DocumentRecord), 1)));
+    std::vector<std::filesystem::path> runs;
+    for (uint64_t left = document_count_; left > 0;) {
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(left, records.size()));
+        if (!input.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(count * sizeof(DocumentRecord)))) {
+            throw std::runtime_error("cannot read "s + documents_path_.string());
+        }
+        std::sort(records.begin(), records.begin() + count, by_id);
+        left -= count;
+        if (runs.empty() && left == 0) {
+            // fits in the budget: no run is spilled
+            records.resize(count);
+            break;
+        }
+        runs.push_back(AddMergeFile(".documents" + std::to_string(runs.size())));
+        std::ofstream run(runs.back(), std::ios::binary | std::ios::trunc);
+        run.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(count * sizeof(DocumentRecord)));
+        if (!run) {
+            throw std::runtime_error("cannot write run "s + runs.back().string());
+        }
+    }
+    input.close();
+
+    std::optional<int32_t> last_id;
+    const auto write = [&](const DocumentRecord& record) {
+        if (last_id == record.id) {
+            throw std::invalid_argument("ID already exists"s);
+        }
+        last_id = record.id;
+        WriteValue(output, record);
+    };
+    if (runs.empty()) {
+        std::for_each(records.begin(), records.end(), write);
+        return;
+    }
+    records = {};
+
+    // k-way merge, a record of every run in memory
+    std::vector<std::ifstream> readers;
+    std::vector<DocumentRecord> heads(runs.size());
+    const auto ranks_after = [&heads](size_t lhs, size_t rhs) {
+        return heads[lhs].id > heads[rhs].id;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(ranks_after)> order(ranks_after);
+    for (const std::filesystem::path& run : runs) {
+        readers.emplace_back(run, std::ios::binary);
+        if (ReadValue(readers.back(), heads[readers.size() - 1])) {
+            order.push(readers.size() - 1);
+        }
+    }
+    while (!order.empty()) {
+        const size_t run = order.top();
+        order.pop();
+        write(heads[run]);
+        if (ReadValue(readers[run], heads[run])) {
+            order.push(run);
+        }
+    }
+}
+
+std::filesystem::path ExternalIndexBuilder::AddMergeFile(const std::string& suffix) {
+    merge_files_.push_back(MakeTemporaryPath(suffix));
+    return merge_files_.back();
+}
+
+std::filesystem::path ExternalIndexBuilder::MakeTemporaryPath(const std::string& suffix) const {
+    return options_.run_directory / (index_path_.filename().string() + suffix);
+}
+
+void ExternalIndexBuilder::SpillRun() {
+    const std::filesystem::path path = MakeTemporaryPath(".run" + std::to_string(runs_.size()));
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    runs_.push_back(path);
+    for (auto& [word, postings] : postings_) {
+        // documents come in any order of ids, the merge takes them sorted
+        std::sort(postings.begin(), postings.end());
+        WriteValue(output, static_cast<uint32_t>(word.size()));
+        output.write(word.data(), static_cast<std::streamsize>(word.size()));
+        WriteValue(output, static_cast<uint32_t>(postings.size()));
+        for (const auto& [document_id, term_freq] : postings) {
+            WriteValue(output, static_cast<int32_t>(document_id));
+            WriteValue(output, term_freq);
+        }
+    }
+    output.close();
+    if (!output) {
+        throw std::runtime_error("cannot write run "s + path.string());
+    }
+    postings_.clear();
+    buffered_bytes_ = 0;
+}
+
+void ExternalIndexBuilder::RemoveTemporaryFiles() noexcept {
+    std::error_code error;
+    for (const std::filesystem::path& run : runs_) {
+        std::filesystem::remove(run, error);
+    }
+    runs_.clear();
+    for (const std::filesystem::path& file : merge_files_) {
+        std::filesystem::remove(file, error);
+    }
+    merge_files_.clear();
+    if (documents_.is_open()) {
+        documents_.close();
+    }
+    std::filesystem::remove(documents_path_, error);
+}
+
+ExternalIndex::ExternalIndex(const std::filesystem::path& index_path, TokenizerOptions tokenizer_options)
+    : tokenizer_(std::move(tokenizer_options)) {
+#ifdef __unix__
+    const int file = ::open(index_path.c_str(), O_RDONLY);
+    struct stat status {};
+    if (file >= 0 && ::fstat(file, &status) == 0 && status.st_size > 0) {
+        void* const mapping = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+        if (mapping != MAP_FAILED) {
+            data_ = static_cast<const char*>(mapping);
+            size_ = static_cast<size_t>(status.st_size);
+            is_mapped_ = true;
+        }
+    }
+    if (file >= 0) {
+        ::close(file);
+    }
+#endif
+    if (!is_mapped_) {
+        std::ifstream input(index_path, std::ios::binary);
+        buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+
+    header_ = reinterpret_cast<const index_file::Header*>(data_);
+    if (!HasValidLayout()) {
+#ifdef __unix__
+        if (is_mapped_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        throw std::runtime_error("invalid index file "s + index_path.string());
+    }
+    documents_ = reinterpret_cast<const index_file::DocumentRecord*>(data_ + header_->documents_offset);
+    terms_ = reinterpret_cast<const index_file::TermRecord*>(data_ + header_->terms_offset);
+}
+
+bool ExternalIndex::HasValidLayout() const noexcept {
+    using index_file::AlignUp;
+    if (size_ < sizeof(index_file::Header) || std::memcmp(header_->magic, index_file::MAGIC, sizeof(header_->magic)) != 0
+        || header_->file_size != size_) {
+        return false;
+    }
+    // documents, postings, terms and strings follow each other; counts are divided, not multiplied, against overflow
+    const uint64_t documents_offset = header_->documents_offset;
+    if (documents_offset != sizeof(index_file::Header)
+        || header_->document_count > (size_ - documents_offset) / sizeof(index_file::DocumentRecord)) {
+        return false;
+    }
+    const uint64_t postings_offset = AlignUp(documents_offset + header_->document_count * sizeof(index_file::DocumentRecord));
+    const uint64_t terms_offset = header_->terms_offset;
+    if (terms_offset % 8 != 0 || terms_offset < postings_offset || terms_offset > size_
+        || header_->term_count > (size_ - terms_offset) / sizeof(index_file::TermRecord)
+        || header_->strings_offset != terms_offset + header_->term_count * sizeof(index_file::TermRecord)) {
+        return false;
+    }
+    const uint64_t strings_size = size_ - header_->strings_offset;
+    const index_file::TermRecord* const terms = reinterpret_cast<const index_file::TermRecord*>(data_ + terms_offset);
+    for (uint64_t i = 0; i < header_->term_count; ++i) {
+        const index_file::TermRecord& term = terms[i];
+        // document_freq is 32 bits, so the size of the postings can't overflow
+        const uint64_t postings_size = AlignUp(uint64_t{ term.document_freq } * sizeof(int32_t))
+            + uint64_t{ term.document_freq } * sizeof(double);
+        if (term.string_offset > strings_size || term.string_length > strings_size - term.string_offset
+            || term.postings_offset % 8 != 0 || term.postings_offset < postings_offset || term.postings_offset > terms_offset
+            || postings_size > terms_offset - term.postings_offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ExternalIndex::~ExternalIndex() {
+#ifdef __unix__
+    if (is_mapped_) {
+        ::munmap(const_cast<char*>(data_), size_);
+        is_mapped_ = false;
+    }
+#endif
+}
+
+ExternalIndex::PostingsView ExternalIndex::FindPostings(std::string_view word) const {
+    const index_file::TermRecord* const terms_end = terms_ + header_->term_count;
+    const auto word_of = [this](const index_file::TermRecord& term) {
+        return std::string_view(data_ + header_->strings_offset + term.string_offset, term.string_length);
+    };
+    const index_file::TermRecord* const term = std::lower_bound(terms_, terms_end, word,
+        [&word_of](const index_file::TermRecord& term, std::string_view word) {
+            return word_of(term) < word;
+        });
+    if (term == terms_end || word_of(*term) != word) {
+        return {};
+    }
+    const char* const postings = data_ + term->postings_offset;
+    return { reinterpret_cast<const int32_t*>(postings),
+        reinterpret_cast<const double*>(postings + index_file::AlignUp(term->document_freq * sizeof(int32_t))),
+        term->document_freq };
+}
+
+const index_file::DocumentRecord* ExternalIndex::FindDocumentAfter(const index_file::DocumentRecord* document,
+    int document_id) const {
+    const index_file::DocumentRecord* const documents_end = documents_ + header_->document_count;
+    size_t step = 1;
+    const index_file::DocumentRecord* bound = document;
+    while (bound < documents_end && bound->id < document_id) {
+        document = bound + 1;
+        bound = static_cast<size_t>(documents_end - document) > step ? document + step : documents_end;
+        step *= 2;
+    }
+    return std::lower_bound(document, bound, document_id, [](const index_file::DocumentRecord& record, int document_id) {
+        return record.id < document_id;
+        });
+}
+
+void ExternalIndex::ParseQuery(std::string_view raw_query, std::pmr::vector<std::string_view>& plus_words,
+    std::pmr::vector<std::string_view>& minus_words, std::pmr::memory_resource* resource) const {
+    std::pmr::vector<std::string_view> words(resource);
+    if (!tokenizer_.Split(raw_query, words, resource)) {
+        throw std::invalid_argument("invalid request"s);
+    }
+    for (std::string_view word : words) {
+        const bool is_minus = word[0] == '-';
+        if (is_minus) {
+            word.remove_prefix(1);
+        }
+        if (word.empty() || word[0] == '-') {
+            throw std::invalid_argument("invalid request"s);
+        }
+        (is_minus ? minus_words : plus_words).push_back(word);
+    }
+    for (std::pmr::vector<std::string_view>* query_words : { &plus_words, &minus_words }) {
+        std::sort(query_words->begin(), query_words->end());
+        query_words->erase(std::unique(query_words->begin(), query_words->end()), query_words->end());
+    }
+}
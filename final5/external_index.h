@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "ranking_key.h"
+#include "scoring.h"
+#include "search_server.h"
+#include "stop_word_filter.h"
+#include "tokenizer.h"
+
+// Layout of an index file, in the byte order of the machine that built it:
+// Header, DocumentRecord[document_count] sorted by id, the postings of every term
+// (int32_t ids sorted, padded to 8 bytes, then double term frequencies),
+// TermRecord[term_count] sorted by word, then the bytes of the words.
+// Every section starts at a multiple of 8 bytes, so a mapped file is read in place.
+namespace index_file {
+
+inline constexpr char MAGIC[8] = { 'S', 'S', 'I', 'D', 'X', '0', '0', '1' };
+
+struct Header {
+    char magic[8];
+    uint64_t document_count;
+    uint64_t term_count;
+    uint64_t total_length;
+    uint64_t documents_offset;
+    uint64_t terms_offset;
+    uint64_t strings_offset;
+    uint64_t file_size;
+};
+
+struct DocumentRecord {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    uint32_t length;
+};
+
+struct TermRecord {
+    uint64_t string_offset;
+    uint32_t string_length;
+    uint32_t document_freq;
+    uint64_t postings_offset;
+};
+
+inline uint64_t AlignUp(uint64_t offset) noexcept {
+    return (offset + 7) & ~uint64_t{ 7 };
+}
+
+} // namespace index_file
+
+struct ExternalIndexOptions {
+    // where the sorted runs are spilled; next to the index file if empty
+    std::filesystem::path run_directory;
+    // postings buffered in memory before a run is spilled, estimated
+    size_t memory_budget = 64 << 20;
+    TokenizerOptions tokenizer;
+};
+
+// Builds an index file from more documents than fit in memory.
+// Postings are buffered up to the budget, then written as a run sorted by word and id;
+// Finish merges the runs k ways, holding one posting of every run in memory.
+// The table of documents is sorted in runs of the budget and merged the same way;
+// the table of terms is written in order to a temporary file, so neither is held in memory.
+//
+//     ExternalIndexBuilder builder("corpus.idx", "and in on"s);
+//     builder.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, { 5 });
+//     builder.Finish();
+//     const ExternalIndex index("corpus.idx");
+class ExternalIndexBuilder {
+public:
+    ExternalIndexBuilder(std::filesystem::path index_path, const std::string& stop_words, ExternalIndexOptions options = {});
+
+    ExternalIndexBuilder(const ExternalIndexBuilder&) = delete;
+    ExternalIndexBuilder& operator=(const ExternalIndexBuilder&) = delete;
+
+    // Removes the runs left by an unfinished build
+    ~ExternalIndexBuilder();
+
+    // Words and term frequencies as in SearchServer::AddDocument; repeated ids are found by Finish
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Writes the index file; the builder takes no documents afterwards
+    void Finish();
+
+    inline size_t GetRunCount() const noexcept {
+        return runs_.size();
+    }
+
+private:
+    using RunPostings = std::vector<std::pair<int, double>>;
+
+    std::filesystem::path index_path_;
+    ExternalIndexOptions options_;
+    Tokenizer tokenizer_;
+    StopWordFilter stop_words_;
+
+    std::map<std::string, RunPostings, std::less<>> postings_;
+    size_t buffered_bytes_ = 0;
+    std::vector<std::filesystem::path> runs_;
+
+    std::filesystem::path documents_path_;
+    std::ofstream documents_;
+    uint64_t document_count_ = 0;
+    uint64_t total_length_ = 0;
+    bool is_finished_ = false;
+
+    // written by Finish
+    std::vector<std::filesystem::path> merge_files_;
+
+    std::filesystem::path MakeTemporaryPath(const std::string& suffix) const;
+
+    // A temporary file of Finish, removed with the runs
+    std::filesystem::path AddMergeFile(const std::string& suffix);
+
+    // The records of the documents sorted by id; throws std::invalid_argument on a repeated id
+    void WriteDocuments(std::ostream& output);
+
+    void SpillRun();
+
+    void RemoveTemporaryFiles() noexcept;
+};
+
+// Read-only view of an index file, mapped into memory where the platform allows it
+class ExternalIndex {
+public:
+    // tokenizer_options must be those of the builder; a file whose sections don't fit throws std::runtime_error
+    explicit ExternalIndex(const std::filesystem::path& index_path, TokenizerOptions tokenizer_options = {});
+
+    ExternalIndex(const ExternalIndex&) = delete;
+    ExternalIndex& operator=(const ExternalIndex&) = delete;
+
+    ~ExternalIndex();
+
+    inline size_t GetDocumentCount() const noexcept {
+        return header_->document_count;
+    }
+
+    inline size_t GetTermCount() const noexcept {
+        return header_->term_count;
+    }
+
+    inline CollectionStatistics GetCollectionStatistics() const noexcept {
+        return { header_->document_count,
+            header_->document_count == 0 ? 0.0 : header_->total_length * 1.0 / header_->document_count };
+    }
+
+    // Exact plus and minus words only; ranked as SearchServer::FindTopDocuments ranks the same documents
+    template <typename Scoring = TfIdf>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+private:
+    struct PostingsView {
+        const int32_t* document_ids = nullptr;
+        const double* term_freqs = nullptr;
+        size_t size = 0;
+    };
+
+    Tokenizer tokenizer_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    // the file, if it could not be mapped
+    std::vector<char> buffer_;
+    bool is_mapped_ = false;
+
+    const index_file::Header* header_ = nullptr;
+    const index_file::DocumentRecord* documents_ = nullptr;
+    const index_file::TermRecord* terms_ = nullptr;
+
+    // Every section, word and postings list lies in the file, without overflow, and is aligned
+    bool HasValidLayout() const noexcept;
+
+    PostingsView FindPostings(std::string_view word) const;
+
+    // Gallops from a document with a smaller id: close ids are found in a few steps
+    const index_file::DocumentRecord* FindDocumentAfter(const index_file::DocumentRecord* document, int document_id) const;
+
+    // Sorted unique words; throws std::invalid_argument as SearchServer does
+    void ParseQuery(std::string_view raw_query, std::pmr::vector<std::string_view>& plus_words,
+        std::pmr::vector<std::string_view>& minus_words, std::pmr::memory_resource* resource) const;
+};
+
+template <typename Scoring>
+std::vector<Document> ExternalIndex::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    std::pmr::vector<std::string_view> plus_words(&arena);
+    std::pmr::vector<std::string_view> minus_words(&arena);
+    ParseQuery(raw_query, plus_words, minus_words, &arena);
+
+    struct PlusCursor {
+        PostingsView postings;
+        typename Scoring::TermScorer term_scorer;
+        size_t position = 0;
+    };
+    const CollectionStatistics collection = GetCollectionStatistics();
+    std::pmr::vector<PlusCursor> plus_cursors(&arena);
+    for (const std::string_view word : plus_words) {
+        const PostingsView postings = FindPostings(word);
+        if (postings.size > 0) {
+            plus_cursors.push_back({ postings, typename Scoring::TermScorer(collection, postings.size) });
+        }
+    }
+    std::pmr::vector<std::pair<PostingsView, size_t>> minus_cursors(&arena);
+    for (const std::string_view word : minus_words) {
+        minus_cursors.emplace_back(FindPostings(word), 0);
+    }
+
+    // document at a time: the postings and the documents are sorted by id, so every list is read once
+    std::vector<Document> matched_documents;
+    const index_file::DocumentRecord* document = documents_;
+    while (true) {
+        int32_t document_id = INT32_MAX;
+        for (const PlusCursor& cursor : plus_cursors) {
+            if (cursor.position < cursor.postings.size) {
+                document_id = std::min(document_id, cursor.postings.document_ids[cursor.position]);
+            }
+        }
+        if (document_id == INT32_MAX) {
+            break;
+        }
+        document = FindDocumentAfter(document, document_id);
+        if (document == documents_ + header_->document_count || document->id != document_id) {
+            throw std::runtime_error("invalid index file: a posting of an unknown document");
+        }
+
+        // summed in the order of the words, as in SearchServer
+        double relevance = 0.0;
+        for (PlusCursor& cursor : plus_cursors) {
+            if (cursor.position < cursor.postings.size && cursor.postings.document_ids[cursor.position] == document_id) {
+                relevance += cursor.term_scorer(cursor.postings.term_freqs[cursor.position], static_cast<int>(document->length));
+                ++cursor.position;
+            }
+        }
+        bool is_excluded = document->status != static_cast<int32_t>(status);
+        for (auto& [postings, position] : minus_cursors) {
+            position = std::lower_bound(postings.document_ids + position, postings.document_ids + postings.size, document_id)
+                - postings.document_ids;
+            is_excluded = is_excluded || (position < postings.size && postings.document_ids[position] == document_id);
+        }
+        if (!is_excluded) {
+            matched_documents.emplace_back(document_id, relevance, document->rating);
+        }
+    }
+
+    const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), RanksBefore);
+    matched_documents.erase(top_end, matched_documents.end());
+    return matched_documents;
+}
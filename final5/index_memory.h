@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+
+#include "tracking_resource.h"
+
+enum class IndexAllocation {
+    HEAP, // every node of the index is allocated with operator new
+    POOL, // nodes come from size-segregated pools carved out of large chunks
+};
+
+// What the containers of a SearchServer hold, each part counted by its own resource
+enum class IndexCategory {
+    TERM_DICTIONARY, // word -> postings nodes and the words
+    POSTINGS,        // slots and term frequencies
+    FORWARD_INDEX,   // document -> word frequencies
+    DOCUMENT_METADATA,
+};
+
+// Bytes of a SearchServer, as the containers asked for them
+struct IndexMemoryStats {
+    size_t term_dictionary = 0;
+    size_t postings = 0;
+    size_t forward_index = 0;
+    size_t document_metadata = 0;
+    // capacity of the stop word filter, outside of the resources
+    size_t stop_words = 0;
+    // the sum of the above
+    size_t total = 0;
+    // taken from operator new by the containers: with pools, their chunks, free space included
+    size_t heap = 0;
+    size_t peak_heap = 0;
+    // total per document, 0 without documents
+    double per_document = 0.0;
+};
+
+// Memory of the containers of one SearchServer.
+// Not thread-safe, as the containers themselves.
+class IndexMemory {
+public:
+    inline static constexpr size_t CATEGORY_COUNT = static_cast<size_t>(IndexCategory::DOCUMENT_METADATA) + 1;
+
+private:
+    // what the index takes from operator new
+    TrackingResource heap_;
+    std::optional<std::pmr::unsynchronized_pool_resource> pool_;
+    // in front of the pool or the heap
+    std::array<TrackingResource, CATEGORY_COUNT> categories_;
+
+    std::pmr::memory_resource* MakeUpstream(IndexAllocation allocation) {
+        if (allocation == IndexAllocation::POOL) {
+            pool_.emplace(&heap_);
+        }
+        return GetResource();
+    }
+
+public:
+    explicit IndexMemory(IndexAllocation allocation)
+        : categories_{ TrackingResource(MakeUpstream(allocation)), TrackingResource(GetResource()),
+            TrackingResource(GetResource()), TrackingResource(GetResource()) } {}
+
+    IndexMemory(const IndexMemory&) = delete;
+    IndexMemory& operator=(const IndexMemory&) = delete;
+
+    // The pool or the heap, under the resources of the categories
+    inline std::pmr::memory_resource* GetResource() noexcept {
+        return pool_ ? static_cast<std::pmr::memory_resource*>(&*pool_) : &heap_;
+    }
+
+    inline TrackingResource* GetResource(IndexCategory category) noexcept {
+        return &categories_[static_cast<size_t>(category)];
+    }
+
+    inline const TrackingResource& GetCategory(IndexCategory category) const noexcept {
+        return categories_[static_cast<size_t>(category)];
+    }
+
+    inline IndexAllocation GetAllocation() const noexcept {
+        return pool_ ? IndexAllocation::POOL : IndexAllocation::HEAP;
+    }
+
+    inline const TrackingResource& GetHeap() const noexcept {
+        return heap_;
+    }
+
+    // Returns the chunks of the pool to the heap at once; every container must be empty
+    inline void Release() {
+        if (pool_) {
+            pool_->release();
+        }
+    }
+};
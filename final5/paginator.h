@@ -1,5 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
 template<typename It>
 class IteratorRange {
     It begin_;
@@ -19,34 +27,100 @@ std::ostream& operator<<(std::ostream& os, const IteratorRange<It>& ir) {
     return os;
 }
 
+namespace detail {
+
+// it advanced by n, or end if that is closer
+template <typename It>
+It AdvanceAtMost(It it, const It end, size_t n) {
+    using Category = typename std::iterator_traits<It>::iterator_category;
+    if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+        return it + static_cast<typename std::iterator_traits<It>::difference_type>(
+            std::min(static_cast<size_t>(end - it), n));
+    }
+    else {
+        for (; n > 0 && it != end; --n) {
+            ++it;
+        }
+        return it;
+    }
+}
+
+} // namespace detail
+
+// Pages of a range, found as they are iterated; forward iterators are enough
 template <typename It>
 class Paginator {
-    std::vector<IteratorRange<It>> range_;
     It begin_;
     It end_;
+    size_t page_size_;
 
 public:
-    Paginator(const It begin, const It end, const size_t size) :begin_(begin), end_(end) {
-        while (begin_ != end_) {
-            int distance = std::distance(begin_, end_);
-
-            if (distance > static_cast<int>(size)) {
-                distance = size;
-            }
-            range_.push_back({ begin_, begin_ + distance });
-            std::advance(begin_, distance);
+    class PageIterator {
+        It page_begin_;
+        It page_end_;
+        It end_;
+        size_t page_size_;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<It>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<It>;
+
+        PageIterator(It page_begin, It end, size_t page_size)
+            : page_begin_(page_begin), page_end_(detail::AdvanceAtMost(page_begin, end, page_size)), end_(end), page_size_(page_size) {}
+
+        IteratorRange<It> operator*() const {
+            return { page_begin_, page_end_ };
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            page_end_ = detail::AdvanceAtMost(page_end_, end_, page_size_);
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
         }
     };
 
-    auto begin()const noexcept{
-        return range_.begin();
+    Paginator(const It begin, const It end, const size_t page_size) : begin_(begin), end_(end), page_size_(page_size) {
+        if (page_size == 0) {
+            throw std::invalid_argument("page size must be positive");
+        }
     }
-    auto end()const noexcept{
-        return range_.end();
+
+    PageIterator begin() const {
+        return PageIterator(begin_, end_, page_size_);
+    }
+
+    PageIterator end() const {
+        return PageIterator(end_, end_, page_size_);
+    }
+
+    // The page with the given index, empty past the end; the pages before it are skipped, not built
+    IteratorRange<It> Page(size_t index) const {
+        const size_t offset = index > SIZE_MAX / page_size_ ? SIZE_MAX : index * page_size_;
+        const It page_begin = detail::AdvanceAtMost(begin_, end_, offset);
+        return { page_begin, detail::AdvanceAtMost(page_begin, end_, page_size_) };
     }
 };
 
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
+    using std::begin;
+    using std::end;
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
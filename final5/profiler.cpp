@@ -0,0 +1,165 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    // buffers outlive their threads so that late exports still see the events
+    std::vector<std::unique_ptr<Profiler::ThreadBuffer>> buffers;
+    // those of exited threads, reused before a new one is allocated
+    std::vector<Profiler::ThreadBuffer*> free_buffers;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+struct PathStatistics {
+    std::vector<uint64_t> durations;
+    uint64_t total_ns = 0;
+};
+
+void PrintJsonString(std::ostream& os, const char* str) {
+    os << '"';
+    for (; *str != '\0'; ++str) {
+        if (*str == '"' || *str == '\\') {
+            os << '\\';
+        }
+        os << *str;
+    }
+    os << '"';
+}
+
+} // namespace
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer() {
+    // gives the buffer back on thread exit; the registry is constructed first, so it is destroyed last
+    struct Owner {
+        ThreadBuffer* buffer;
+
+        ~Owner() {
+            Registry& registry = GetRegistry();
+            std::lock_guard lock(registry.mutex);
+            registry.free_buffers.push_back(buffer);
+        }
+    };
+
+    thread_local const Owner owner{ [] {
+        Registry& registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        if (!registry.free_buffers.empty()) {
+            ThreadBuffer* buffer = registry.free_buffers.back();
+            registry.free_buffers.pop_back();
+            return buffer;
+        }
+        registry.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(registry.buffers.size())));
+        return registry.buffers.back().get();
+    }() };
+    return *owner.buffer;
+}
+
+size_t Profiler::GetThreadBufferCount() {
+    Registry& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    return registry.buffers.size();
+}
+
+std::vector<std::pair<uint32_t, std::vector<Profiler::Event>>> Profiler::Collect() {
+    std::vector<std::pair<uint32_t, std::vector<Event>>> threads;
+
+    Registry& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+        const size_t size = buffer->size_.load(std::memory_order_acquire);
+        std::vector<Event> events(buffer->events_.get(), buffer->events_.get() + size);
+        // scopes are pushed when they end; parents have to go before their children
+        std::sort(events.begin(), events.end(), [](const Event& lhs, const Event& rhs) {
+            return lhs.start_ns != rhs.start_ns ? lhs.start_ns < rhs.start_ns : lhs.depth < rhs.depth;
+            });
+        threads.emplace_back(buffer->thread_id_, std::move(events));
+    }
+    return threads;
+}
+
+void Profiler::PrintSummary(std::ostream& os) {
+    std::map<std::string, PathStatistics> paths;
+    uint64_t dropped = 0;
+
+    for (const auto& [thread_id, events] : Collect()) {
+        // stack of paths of the open scopes, index is the depth
+        std::vector<std::string> stack;
+        for (const Event& event : events) {
+            // parents still running or dropped are shown as "?"
+            stack.resize(event.depth, "?");
+            std::string path = stack.empty() ? event.name : stack.back() + " > " + event.name;
+            PathStatistics& statistics = paths[path];
+            statistics.durations.push_back(event.end_ns - event.start_ns);
+            statistics.total_ns += event.end_ns - event.start_ns;
+            stack.push_back(std::move(path));
+        }
+    }
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+            dropped += buffer->dropped_.load(std::memory_order_relaxed);
+        }
+    }
+
+    os << "path: calls, total/min/p50/p99/max ns\n";
+    for (auto& [path, statistics] : paths) {
+        std::vector<uint64_t>& d = statistics.durations;
+        std::sort(d.begin(), d.end());
+        os << path << ": " << d.size()
+            << ", " << statistics.total_ns
+            << "/" << d.front()
+            << "/" << d[(d.size() - 1) / 2]
+            << "/" << d[(d.size() - 1) * 99 / 100]
+            << "/" << d.back() << "\n";
+    }
+    if (dropped > 0) {
+        os << "dropped events: " << dropped << "\n";
+    }
+}
+
+void Profiler::WriteChromeTrace(std::ostream& os) {
+    const auto threads = Collect();
+
+    uint64_t origin_ns = UINT64_MAX;
+    for (const auto& [thread_id, events] : threads) {
+        if (!events.empty()) {
+            origin_ns = std::min(origin_ns, events.front().start_ns);
+        }
+    }
+
+    os << "{\"traceEvents\": [";
+    bool first = true;
+    for (const auto& [thread_id, events] : threads) {
+        for (const Event& event : events) {
+            os << (first ? "\n" : ",\n") << "{\"name\": ";
+            PrintJsonString(os, event.name);
+            // timestamps are in microseconds
+            os << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread_id
+                << ", \"ts\": " << (event.start_ns - origin_ns) / 1000 << "." << (event.start_ns - origin_ns) % 1000 / 100
+                << ", \"dur\": " << (event.end_ns - event.start_ns) / 1000 << "." << (event.end_ns - event.start_ns) % 1000 / 100
+                << "}";
+            first = false;
+        }
+    }
+    os << "\n]}\n";
+}
+
+void Profiler::Reset() {
+    Registry& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+        buffer->size_.store(0, std::memory_order_relaxed);
+        buffer->dropped_.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Scoped profiler with nanosecond resolution.
+// Define SEARCH_SERVER_PROFILE to enable it; otherwise PROFILE_SCOPE expands to nothing.
+//
+//     void SearchServer::AddDocument(...) {
+//         PROFILE_SCOPE("AddDocument");
+//         ...
+//     }
+//
+// Every thread writes finished scopes to its own fixed-size buffer without locking.
+// Profiler::PrintSummary aggregates them by call path, Profiler::WriteChromeTrace
+// dumps them in the Chrome trace-event format (chrome://tracing, Perfetto).
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_PROFILE
+// name must be a string literal or have static storage duration
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+class Profiler {
+public:
+    struct Event {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t end_ns;
+        uint32_t depth;
+    };
+
+    // Events recorded after a thread's buffer is full are dropped and counted
+    inline static constexpr size_t THREAD_BUFFER_CAPACITY = 1 << 16;
+
+    class ThreadBuffer {
+    public:
+        explicit ThreadBuffer(uint32_t thread_id) : events_(new Event[THREAD_BUFFER_CAPACITY]), thread_id_(thread_id) {}
+
+        // Only the owner thread calls Push
+        inline void Push(const Event& event) noexcept {
+            const size_t size = size_.load(std::memory_order_relaxed);
+            if (size == THREAD_BUFFER_CAPACITY) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            events_[size] = event;
+            size_.store(size + 1, std::memory_order_release);
+        }
+
+        inline uint32_t EnterScope() noexcept {
+            return depth_++;
+        }
+
+        inline void LeaveScope() noexcept {
+            depth_--;
+        }
+
+    private:
+        friend class Profiler;
+
+        std::unique_ptr<Event[]> events_;
+        std::atomic<size_t> size_{ 0 };
+        std::atomic<uint64_t> dropped_{ 0 };
+        uint32_t depth_ = 0;
+        const uint32_t thread_id_;
+    };
+
+    static inline uint64_t Now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The buffer of the calling thread, registered on first use. A buffer goes to the next thread
+    // once its thread exits, its events kept: threads are lanes of the trace, their count bounds the memory
+    static ThreadBuffer& GetThreadBuffer();
+
+    // Buffers allocated so far, THREAD_BUFFER_CAPACITY events each
+    static size_t GetThreadBufferCount();
+
+    // Call counts, total/min/max/p50/p99 time per call path
+    static void PrintSummary(std::ostream&);
+
+    static void WriteChromeTrace(std::ostream&);
+
+    // Must not run concurrently with profiled code
+    static void Reset();
+
+private:
+    // Events of every thread, sorted by start time; used by the exporters
+    static std::vector<std::pair<uint32_t, std::vector<Event>>> Collect();
+};
+
+class ProfileScope {
+    Profiler::ThreadBuffer& buffer_;
+    const char* name_;
+    uint32_t depth_;
+    uint64_t start_ns_;
+
+public:
+    explicit ProfileScope(const char* name) noexcept
+        : buffer_(Profiler::GetThreadBuffer()), name_(name), depth_(buffer_.EnterScope()), start_ns_(Profiler::Now()) {}
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope() {
+        buffer_.Push({ name_, start_ns_, Profiler::Now(), depth_ });
+        buffer_.LeaveScope();
+    }
+};
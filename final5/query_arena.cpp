@@ -0,0 +1,49 @@
+#include "query_arena.h"
+
+#include <algorithm>
+
+QueryArena& QueryArena::ForThisThread() {
+    thread_local QueryArena arena;
+    return arena;
+}
+
+void QueryArena::Reset() {
+    if (chunks_.size() > 1) {
+        const size_t capacity = GetCapacity();
+        chunks_.clear();
+        AddChunk(capacity);
+    }
+    current_ = 0;
+    position_ = chunks_.empty() ? nullptr : chunks_.front().data.get();
+    remaining_ = chunks_.empty() ? 0 : chunks_.front().size;
+}
+
+void QueryArena::AddChunk(size_t size) {
+    chunks_.push_back({ std::unique_ptr<std::byte[]>(new std::byte[size]), size });
+    upstream_allocations_++;
+}
+
+void* QueryArena::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = position_;
+    if (pointer == nullptr || std::align(alignment, bytes, pointer, remaining_) == nullptr) {
+        // the next chunk, existing or new, has to hold the whole request
+        const size_t required = bytes + alignment;
+        while (current_ + 1 < chunks_.size() && chunks_[current_ + 1].size < required) {
+            current_++;
+        }
+        if (current_ + 1 < chunks_.size()) {
+            current_++;
+        }
+        else {
+            const size_t last_size = chunks_.empty() ? INITIAL_CHUNK_SIZE / 2 : chunks_.back().size;
+            AddChunk(std::max(2 * last_size, required));
+            current_ = chunks_.size() - 1;
+        }
+        pointer = chunks_[current_].data.get();
+        remaining_ = chunks_[current_].size;
+        std::align(alignment, bytes, pointer, remaining_);
+    }
+    position_ = static_cast<std::byte*>(pointer) + bytes;
+    remaining_ -= bytes;
+    return pointer;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for the data living as long as one query.
+// Deallocation is a no-op; the memory is reclaimed all at once when the outermost
+// Scope ends. The chunks are kept for the next query, so once the arena has grown
+// to the size of the largest query it makes no more upstream allocations.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    inline static constexpr size_t INITIAL_CHUNK_SIZE = 64 * 1024;
+
+    // Arena of the calling thread
+    static QueryArena& ForThisThread();
+
+    // Scopes may nest: only the outermost one resets the arena
+    class Scope {
+        QueryArena& arena_;
+
+    public:
+        explicit Scope(QueryArena& arena) noexcept : arena_(arena) {
+            arena_.depth_++;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            if (--arena_.depth_ == 0) {
+                arena_.Reset();
+            }
+        }
+    };
+
+    QueryArena() = default;
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    // Chunks allocated with operator new so far
+    inline uint64_t GetUpstreamAllocations() const noexcept {
+        return upstream_allocations_;
+    }
+
+    inline size_t GetCapacity() const noexcept {
+        size_t capacity = 0;
+        for (const Chunk& chunk : chunks_) {
+            capacity += chunk.size;
+        }
+        return capacity;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0;
+    std::byte* position_ = nullptr;
+    size_t remaining_ = 0;
+    size_t depth_ = 0;
+    uint64_t upstream_allocations_ = 0;
+
+    // Rewinds to the first chunk; chunks are merged into one if the last query needed several
+    void Reset();
+
+    void AddChunk(size_t size);
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
@@ -0,0 +1,55 @@
+#include "query_cache.h"
+
+const std::vector<Document>* QueryCache::Find(const std::string& key, uint64_t generation) {
+    const std::vector<Document>* result = FindAlias(key, generation);
+    if (result == nullptr) {
+        statistics_.misses++;
+    }
+    return result;
+}
+
+const std::vector<Document>* QueryCache::FindAlias(const std::string& key, uint64_t generation) {
+    Invalidate(generation);
+
+    const auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    statistics_.hits++;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->result;
+}
+
+void QueryCache::Insert(const std::string& key, uint64_t generation, const std::vector<Document>& result) {
+    if (capacity_ == 0) {
+        return;
+    }
+    Invalidate(generation);
+
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->result = result;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+        statistics_.evictions++;
+    }
+    entries_.push_front({ key, result });
+    index_.emplace(entries_.front().key, entries_.begin());
+}
+
+void QueryCache::Invalidate(uint64_t generation) {
+    if (generation == generation_) {
+        return;
+    }
+    if (!entries_.empty()) {
+        statistics_.invalidations++;
+    }
+    index_.clear();
+    entries_.clear();
+    generation_ = generation;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// LRU cache of top documents keyed by a normalized query.
+// Entries are valid for one generation of the index only: the first lookup
+// with a newer generation drops the whole cache.
+class QueryCache {
+
+    struct Entry {
+        std::string key;
+        std::vector<Document> result;
+    };
+
+public:
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+    };
+
+    explicit QueryCache(size_t capacity) : capacity_(capacity) {}
+
+    // Returns nullptr on a miss. The pointer is valid until the next Insert
+    const std::vector<Document>* Find(const std::string& key, uint64_t generation);
+
+    // Find by a cheaper key of the same result, tried first: its miss is not counted, the Find that follows counts it
+    const std::vector<Document>* FindAlias(const std::string& key, uint64_t generation);
+
+    void Insert(const std::string& key, uint64_t generation, const std::vector<Document>& result);
+
+    inline size_t GetSize() const noexcept {
+        return entries_.size();
+    }
+
+    inline size_t GetCapacity() const noexcept {
+        return capacity_;
+    }
+
+    inline const Statistics& GetStatistics() const noexcept {
+        return statistics_;
+    }
+
+private:
+    const size_t capacity_;
+
+    uint64_t generation_ = 0;
+
+    // front is the most recently used entry
+    std::list<Entry> entries_;
+
+    // keys are views of Entry::key
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+
+    Statistics statistics_;
+
+    void Invalidate(uint64_t generation);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+
+#include "document.h"
+
+// Total order of search results, the same in every execution mode:
+// relevance rounded to RELEVANCE_QUANTUM descending, then rating descending, then id ascending.
+// Relevances closer than the quantum usually compare equal and fall through to the rating,
+// as the former epsilon comparison intended, but unlike it the order is transitive.
+struct RankingKey {
+    inline static constexpr double RELEVANCE_QUANTUM = 1e-6;
+
+    int64_t relevance = 0;
+    int rating = 0;
+    int document_id = 0;
+
+    static inline RankingKey Of(const Document& document) noexcept {
+        return { std::llround(document.relevance / RELEVANCE_QUANTUM), document.rating, document.id };
+    }
+
+    // true if lhs goes first
+    friend inline bool operator<(const RankingKey& lhs, const RankingKey& rhs) noexcept {
+        return std::tie(rhs.relevance, rhs.rating, lhs.document_id) < std::tie(lhs.relevance, lhs.rating, rhs.document_id);
+    }
+
+    friend inline bool operator==(const RankingKey& lhs, const RankingKey& rhs) noexcept {
+        return std::tie(lhs.relevance, lhs.rating, lhs.document_id) == std::tie(rhs.relevance, rhs.rating, rhs.document_id);
+    }
+};
+
+// Comparator for sorts, heaps and merges of documents: true if lhs goes first
+inline bool RanksBefore(const Document& lhs, const Document& rhs) noexcept {
+    return RankingKey::Of(lhs) < RankingKey::Of(rhs);
+}
@@ -1,6 +1,112 @@
 #include "remove_duplicates.h"
 
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <tuple>
+
+namespace {
+
+struct SignedDocument {
+    uint64_t signature;
+    uint32_t word_count;
+    int document_id;
+    uint32_t shard;
+    // in the words fetched from the shard
+    uint32_t position;
+};
+
+// Runs f(i) for every i < count on the pool, or here if the pool rejects it, and waits.
+// The first error is rethrown once every task is over, f being used by them
+template <typename F>
+void RunOnPool(ThreadPool& pool, size_t count, F f) {
+    std::vector<std::future<void>> done;
+    done.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        // std::function needs a copyable target, packaged_task is move-only
+        auto task = std::make_shared<std::packaged_task<void()>>([&f, i] { f(i); });
+        done.push_back(task->get_future());
+        if (!pool.Submit([task] { (*task)(); })) {
+            (*task)();
+        }
+    }
+    for (const std::future<void>& task_done : done) {
+        task_done.wait();
+    }
+    for (std::future<void>& task_done : done) {
+        task_done.get();
+    }
+}
+
+// Without the forward index: documents sharing a signature and a word count are
+// compared word by word, the words fetched from the postings in one pass
+std::vector<int> FindDuplicatesBySignature(const SearchServer& search_server) {
+    std::vector<SearchServer::DocumentSignature> documents = search_server.GetSignatures();
+    const auto key = [](const SearchServer::DocumentSignature& document) {
+        return std::tie(document.signature, document.word_count, document.document_id);
+        };
+    std::sort(documents.begin(), documents.end(), [&key](const auto& lhs, const auto& rhs) {
+        return key(lhs) < key(rhs);
+        });
+    const auto same_group = [](const SearchServer::DocumentSignature& lhs, const SearchServer::DocumentSignature& rhs) {
+        return lhs.signature == rhs.signature && lhs.word_count == rhs.word_count;
+        };
+
+    std::vector<SearchServer::DocumentSignature> candidates;
+    for (size_t begin = 0, end = 0; begin < documents.size(); begin = end) {
+        for (end = begin + 1; end < documents.size() && same_group(documents[end], documents[begin]); ++end) {
+        }
+        if (end - begin > 1) {
+            candidates.insert(candidates.end(), documents.begin() + begin, documents.begin() + end);
+        }
+    }
+    std::vector<int> candidate_ids;
+    candidate_ids.reserve(candidates.size());
+    for (const SearchServer::DocumentSignature& document : candidates) {
+        candidate_ids.push_back(document.document_id);
+    }
+    const std::vector<std::vector<std::string_view>> words = search_server.GetWords(candidate_ids);
+
+    // different words under one signature are a collision, each set keeps its lowest id
+    std::vector<int> duplicates;
+    for (size_t begin = 0, end = 0; begin < candidates.size(); begin = end) {
+        std::vector<const std::vector<std::string_view>*> originals;
+        for (end = begin; end < candidates.size() && same_group(candidates[end], candidates[begin]); ++end) {
+            const std::vector<std::string_view>& document_words = words[end];
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(),
+                [&document_words](const std::vector<std::string_view>* original) {
+                    return *original == document_words;
+                });
+            if (is_duplicate) {
+                duplicates.push_back(candidates[end].document_id);
+            }
+            else {
+                originals.push_back(&document_words);
+            }
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+} // namespace
+
 void RemoveDuplicates(SearchServer& search_server) {
+    if (search_server.GetDeduplication() != Deduplication::OFF) {
+        // found as they were added
+        for (const int duplicate : search_server.GetDuplicates()) {
+            std::cout << "Found duplicate document id " << duplicate << "\n";
+            search_server.RemoveDocument(duplicate);
+        }
+        return;
+    }
+    if (search_server.GetForwardIndex() == ForwardIndex::NONE) {
+        for (const int duplicate : FindDuplicatesBySignature(search_server)) {
+            std::cout << "Found duplicate document id " << duplicate << "\n";
+            search_server.RemoveDocument(duplicate);
+        }
+        return;
+    }
 
     std::set<int> duplicates;
 
@@ -9,15 +115,15 @@ void RemoveDuplicates(SearchServer& search_server) {
             if (l_doc >= r_doc) {
                 continue;
             }
-            const std::map<std::string, double>& left = search_server.GetWordFrequencies(l_doc);
-            const std::map<std::string, double>& right = search_server.GetWordFrequencies(r_doc);
+            const SearchServer::WordFrequencies& left = search_server.GetWordFrequencies(l_doc);
+            const SearchServer::WordFrequencies& right = search_server.GetWordFrequencies(r_doc);
 
             if (left.size() != right.size()) {
                 continue;
             }
 
-            std::map<std::string, double>::const_iterator l_it = left.begin();
-            std::map<std::string, double>::const_iterator r_it = right.begin();
+            SearchServer::WordFrequencies::const_iterator l_it = left.begin();
+            SearchServer::WordFrequencies::const_iterator r_it = right.begin();
 
             bool equal = true;
             while (l_it != left.end()) {
@@ -41,4 +147,99 @@ void RemoveDuplicates(SearchServer& search_server) {
             search_server.RemoveDocument(d);
         }
     }
-}
\ No newline at end of file
+}
+
+std::vector<int> RemoveDuplicates(ThreadPool& pool, std::vector<SearchServer>& shards) {
+    const size_t partition_count = std::max<size_t>(pool.GetThreadCount(), 1);
+
+    // every shard signs its documents and scatters them over the partitions
+    std::vector<std::vector<std::vector<SignedDocument>>> scattered(shards.size(),
+        std::vector<std::vector<SignedDocument>>(partition_count));
+    RunOnPool(pool, shards.size(), [&](size_t shard) {
+        for (const SearchServer::DocumentSignature& document : shards[shard].GetSignatures()) {
+            scattered[shard][document.signature % partition_count].push_back(
+                { document.signature, document.word_count, document.document_id, static_cast<uint32_t>(shard), 0 });
+        }
+        });
+
+    // every partition gathers its signatures from the shards; equal ones are next to each other,
+    // the lowest id first. Those alone are dropped
+    std::vector<std::vector<SignedDocument>> candidates(partition_count);
+    RunOnPool(pool, partition_count, [&](size_t partition) {
+        std::vector<SignedDocument> documents;
+        for (auto& shard_partitions : scattered) {
+            documents.insert(documents.end(), shard_partitions[partition].begin(), shard_partitions[partition].end());
+            std::vector<SignedDocument>().swap(shard_partitions[partition]);
+        }
+        const auto key = [](const SignedDocument& document) {
+            return std::tie(document.signature, document.word_count, document.document_id, document.shard);
+            };
+        std::sort(documents.begin(), documents.end(), [&key](const SignedDocument& lhs, const SignedDocument& rhs) {
+            return key(lhs) < key(rhs);
+            });
+        for (size_t begin = 0, end = 0; begin < documents.size(); begin = end) {
+            for (end = begin + 1; end < documents.size() && documents[end].signature == documents[begin].signature
+                && documents[end].word_count == documents[begin].word_count; ++end) {
+            }
+            if (end - begin > 1) {
+                candidates[partition].insert(candidates[partition].end(), documents.begin() + begin, documents.begin() + end);
+            }
+        }
+        });
+
+    // the words of the candidates, fetched from their shards
+    std::vector<std::vector<int>> requests(shards.size());
+    for (std::vector<SignedDocument>& partition : candidates) {
+        for (SignedDocument& document : partition) {
+            document.position = static_cast<uint32_t>(requests[document.shard].size());
+            requests[document.shard].push_back(document.document_id);
+        }
+    }
+    std::vector<std::vector<std::vector<std::string_view>>> words(shards.size());
+    RunOnPool(pool, shards.size(), [&](size_t shard) {
+        if (!requests[shard].empty()) {
+            words[shard] = shards[shard].GetWords(requests[shard]);
+        }
+        });
+
+    // a candidate with the words of an earlier one of its signature is a duplicate;
+    // different words under one signature are a collision, each set keeps its first document
+    std::vector<std::vector<std::pair<uint32_t, int>>> duplicates(partition_count);
+    RunOnPool(pool, partition_count, [&](size_t partition) {
+        const std::vector<SignedDocument>& documents = candidates[partition];
+        for (size_t begin = 0, end = 0; begin < documents.size(); begin = end) {
+            std::vector<const std::vector<std::string_view>*> originals;
+            for (end = begin; end < documents.size() && documents[end].signature == documents[begin].signature
+                && documents[end].word_count == documents[begin].word_count; ++end) {
+                const std::vector<std::string_view>& document_words = words[documents[end].shard][documents[end].position];
+                const bool is_duplicate = std::any_of(originals.begin(), originals.end(),
+                    [&document_words](const std::vector<std::string_view>* original) {
+                        return *original == document_words;
+                    });
+                if (is_duplicate) {
+                    duplicates[partition].emplace_back(documents[end].shard, documents[end].document_id);
+                }
+                else {
+                    originals.push_back(&document_words);
+                }
+            }
+        }
+        });
+
+    // every shard removes its own
+    std::vector<std::vector<int>> removals(shards.size());
+    std::vector<int> removed;
+    for (const auto& partition : duplicates) {
+        for (const auto& [shard, document_id] : partition) {
+            removals[shard].push_back(document_id);
+            removed.push_back(document_id);
+        }
+    }
+    RunOnPool(pool, shards.size(), [&](size_t shard) {
+        for (const int document_id : removals[shard]) {
+            shards[shard].RemoveDocument(document_id);
+        }
+        });
+    std::sort(removed.begin(), removed.end());
+    return removed;
+}
@@ -1,5 +1,17 @@
 #pragma once
 
+#include <vector>
+
 #include "search_server.h"
+#include "thread_pool.h"
+
+// Removes every document with the words of a document with a lower id. Recorded duplicates
+// are removed as they are; otherwise documents are compared pairwise with the forward index,
+// or by their signatures without it
+void RemoveDuplicates(SearchServer&);
 
-void RemoveDuplicates(SearchServer&);
\ No newline at end of file
+// Removes, over all the shards, every document with the words of a document with a lower id;
+// between equal ids the lower shard wins. The signatures of every shard are computed on the pool,
+// partitioned by hash, and documents sharing one are compared word by word.
+// Returns the removed ids, ascending. Must not be called from a task of the pool
+std::vector<int> RemoveDuplicates(ThreadPool&, std::vector<SearchServer>& shards);
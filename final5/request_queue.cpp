@@ -1,8 +1,9 @@
 #include "request_queue.h"
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+    // the status overload ANDs the bitmap of the status instead of calling a predicate per candidate
+    return AddCachedRequest(raw_query, "status="s + std::to_string(static_cast<int>(status)), [&](auto cache_lookup) {
+        return search_server_.FindTopDocumentsCached(raw_query, status, cache_lookup);
         });
 }
 
@@ -10,12 +11,25 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
-int RequestQueue::GetNoResultRequests() const {
-    int empty_result = 0;
-    for (const QueryResult& r : requests_) {
-        if (r.request.size() == 0) {
-            empty_result++;
+std::vector<Document> RequestQueue::AddRequestResult(std::vector<Document> result, Clock::time_point start) {
+    const Clock::time_point now = now_();
+
+    while (!requests_.empty() && (requests_.full() || now - requests_.front().time >= window_)) {
+        if (now - requests_.front().time < window_) {
+            evicted_requests_++;
+        }
+        if (requests_.front().result_count == 0) {
+            no_result_requests_--;
         }
+        requests_.pop_front();
+    }
+
+    statistics_.Record(now, now - start, result.size());
+
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+    requests_.push_back({ now, static_cast<uint32_t>(result.size()), static_cast<uint32_t>(latency) });
+    if (result.empty()) {
+        no_result_requests_++;
     }
-    return empty_result;
-}
\ No newline at end of file
+    return result;
+}
@@ -1,41 +1,137 @@
 #pragma once
 
-#include <deque>
+#include <chrono>
+#include <cstdint>
 
 #include "search_server.h"
+#include "query_cache.h"
+#include "ring_buffer.h"
+#include "request_statistics.h"
 
+// Keeps statistics of the requests made during the last window of time (a day by default).
+// Only a compact record of every request is stored, at most `capacity` of them: when more
+// requests come within the window, the oldest records go early and the counters cover the last
+// `capacity` requests only. GetEvictedRequests tells how many went so.
 class RequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    // the source of time, replaced by tests
+    using NowFunction = Clock::time_point (*)();
 
-    struct QueryResult {
-        std::vector<Document> request;
+private:
+    struct RequestRecord {
+        Clock::time_point time;
+        uint32_t result_count = 0;
+        uint32_t latency_us = 0;
     };
 
     const SearchServer& search_server_;
 
-    std::deque<QueryResult> requests_;
+    QueryCache cache_;
+
+    const Clock::duration window_;
+
+    RingBuffer<RequestRecord> requests_;
+
+    // number of records in requests_ with result_count == 0
+    int no_result_requests_ = 0;
 
-    const static int sec_in_day_ = 1440;
+    // records dropped for capacity while still within the window
+    uint64_t evicted_requests_ = 0;
+
+    NowFunction now_;
+
+    RequestStatistics statistics_;
 
 public:
-    explicit RequestQueue(const SearchServer& search_server) :search_server_(search_server) {}
+    inline static constexpr size_t DEFAULT_CACHE_CAPACITY = 4096;
+
+    inline static constexpr std::chrono::minutes MINUTES_IN_DAY{ 1440 };
+
+    inline static constexpr size_t DEFAULT_REQUEST_CAPACITY = 1 << 16;
+
+    // cache_capacity == 0 disables the query cache; capacity == 0 throws std::invalid_argument
+    explicit RequestQueue(const SearchServer& search_server, size_t cache_capacity = DEFAULT_CACHE_CAPACITY,
+        Clock::duration window = MINUTES_IN_DAY, size_t capacity = DEFAULT_REQUEST_CAPACITY, NowFunction now = &Clock::now)
+        :search_server_(search_server), cache_(cache_capacity), window_(window), requests_(capacity), now_(now),
+        statistics_(window) {}
     
+    // Arbitrary predicates can't be compared, so the result is never cached
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string&, DocumentPredicate);
 
+    // predicate_key must identify the predicate: equal keys are expected to select equal documents
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string&, const std::string& predicate_key, DocumentPredicate);
+
     std::vector<Document> AddFindRequest(const std::string&, DocumentStatus);
 
     std::vector<Document> AddFindRequest(const std::string&);
 
-    int GetNoResultRequests() const;
+    // Both counters cover the window ending at the last request. O(1)
+    inline int GetNoResultRequests() const noexcept {
+        return no_result_requests_;
+    }
+
+    inline int GetRequestCount() const noexcept {
+        return static_cast<int>(requests_.size());
+    }
+
+    // Since construction; nonzero if capacity is too small for the rate of requests over the window
+    inline uint64_t GetEvictedRequests() const noexcept {
+        return evicted_requests_;
+    }
+
+    inline const QueryCache::Statistics& GetCacheStatistics() const noexcept {
+        return cache_.GetStatistics();
+    }
+
+    // Latency and result counts of all requests since construction; throughput over the window of the queue
+    inline const RequestStatistics& GetStatistics() const noexcept {
+        return statistics_;
+    }
+
+private:
+    // search(cache_lookup) runs the query on a miss of the raw query, see SearchServer::FindTopDocumentsCached;
+    // key_prefix identifies what it selects besides the query
+    template <typename Search>
+    std::vector<Document> AddCachedRequest(const std::string& raw_query, const std::string& key_prefix, Search search);
+
+    std::vector<Document> AddRequestResult(std::vector<Document>, Clock::time_point start);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document>RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    if (requests_.size() >= sec_in_day_) {
-        requests_.pop_front();
+    const Clock::time_point start = now_();
+    return AddRequestResult(search_server_.FindTopDocuments(raw_query, document_predicate), start);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, const std::string& predicate_key,
+    DocumentPredicate document_predicate) {
+    return AddCachedRequest(raw_query, predicate_key, [&](auto cache_lookup) {
+        return search_server_.FindTopDocumentsCached(raw_query, document_predicate, cache_lookup);
+        });
+}
+
+template <typename Search>
+std::vector<Document> RequestQueue::AddCachedRequest(const std::string& raw_query, const std::string& key_prefix, Search search) {
+    const Clock::time_point start = now_();
+    const uint64_t generation = search_server_.GetGeneration();
+
+    // the query as it came: found without parsing it. '\1' can't be in a normalized key, so the keys don't collide
+    const std::string raw_key = key_prefix + '\1' + raw_query;
+    if (const std::vector<Document>* cached = cache_.FindAlias(raw_key, generation)) {
+        return AddRequestResult(*cached, start);
     }
 
-    //fill queue by all requests
-    requests_.push_back({ search_server_.FindTopDocuments(raw_query, document_predicate) });
-    return requests_.back().request;
-}
\ No newline at end of file
+    // the normalized query, shared by equivalent ones
+    std::string key;
+    std::vector<Document> result = search([&](const std::string& query_key) {
+        key = key_prefix + '|' + query_key;
+        return cache_.Find(key, generation);
+        });
+    cache_.Insert(key, generation, result);
+    cache_.Insert(raw_key, generation, result);
+    return AddRequestResult(std::move(result), start);
+}
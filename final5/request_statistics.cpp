@@ -0,0 +1,114 @@
+#include "request_statistics.h"
+
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+uint64_t LatencyHistogram::GetCount() const noexcept {
+    uint64_t count = 0;
+    for (const std::atomic<uint64_t>& bucket : buckets_) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+double LatencyHistogram::GetMean() const noexcept {
+    const uint64_t count = GetCount();
+    return count == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+}
+
+uint64_t LatencyHistogram::GetValueAtQuantile(double quantile) const noexcept {
+    const uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return BucketLowerBound(i);
+        }
+    }
+    return GetMax();
+}
+
+RequestStatistics::RequestStatistics(Clock::duration qps_window)
+    : step_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(qps_window).count() / static_cast<int64_t>(QPS_BUCKETS)) {
+    if (step_ns_ <= 0) {
+        throw std::invalid_argument("the QPS window is too short");
+    }
+}
+
+void RequestStatistics::Record(Clock::time_point now, Clock::duration latency, size_t result_count) noexcept {
+    const int64_t now_ns = ToNanoseconds(now);
+    const int64_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+
+    latency_.Record(static_cast<uint64_t>(std::max<int64_t>(0, latency_ns)));
+    result_counts_[std::min(result_count, RESULT_COUNT_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t first = -1;
+    first_record_ns_.compare_exchange_strong(first, now_ns, std::memory_order_relaxed);
+
+    const int64_t step = now_ns / step_ns_;
+    StepCounter& counter = steps_[static_cast<size_t>(step) % QPS_BUCKETS];
+    int64_t stamp = counter.step.load(std::memory_order_relaxed);
+    if (stamp != step && counter.step.compare_exchange_strong(stamp, step, std::memory_order_relaxed)) {
+        counter.count.store(0, std::memory_order_relaxed);
+    }
+    counter.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+double RequestStatistics::GetQps(Clock::time_point now) const noexcept {
+    const int64_t now_ns = ToNanoseconds(now);
+    const int64_t first_ns = first_record_ns_.load(std::memory_order_relaxed);
+    if (first_ns < 0) {
+        return 0.0;
+    }
+    const int64_t step = now_ns / step_ns_;
+
+    uint64_t requests = 0;
+    for (const StepCounter& counter : steps_) {
+        if (step - counter.step.load(std::memory_order_relaxed) < static_cast<int64_t>(QPS_BUCKETS)) {
+            requests += counter.count.load(std::memory_order_relaxed);
+        }
+    }
+    // the window is shorter while the statistics are younger than it
+    const double step_seconds = step_ns_ / 1e9;
+    const double elapsed = std::clamp((now_ns - first_ns) / 1e9, step_seconds, step_seconds * QPS_BUCKETS);
+    return requests / elapsed;
+}
+
+void RequestStatistics::PrintText(std::ostream& os, Clock::time_point now) const {
+    os << "requests: " << GetRequestCount() << "\n";
+    os << "qps: " << std::fixed << std::setprecision(2) << GetQps(now) << std::defaultfloat << "\n";
+    os << "latency ns: mean = " << static_cast<uint64_t>(latency_.GetMean())
+        << ", p50 = " << latency_.GetValueAtQuantile(0.5)
+        << ", p99 = " << latency_.GetValueAtQuantile(0.99)
+        << ", p999 = " << latency_.GetValueAtQuantile(0.999)
+        << ", max = " << latency_.GetMax() << "\n";
+    os << "result counts:";
+    for (size_t i = 0; i < RESULT_COUNT_BUCKETS; ++i) {
+        os << " " << i << (i + 1 == RESULT_COUNT_BUCKETS ? "+" : "") << " = " << GetResultCountFrequency(i);
+    }
+    os << "\n";
+}
+
+void RequestStatistics::PrintJson(std::ostream& os, Clock::time_point now) const {
+    os << "{\"requests\": " << GetRequestCount()
+        << ", \"qps\": " << GetQps(now)
+        << ", \"latency_ns\": {\"mean\": " << static_cast<uint64_t>(latency_.GetMean())
+        << ", \"p50\": " << latency_.GetValueAtQuantile(0.5)
+        << ", \"p99\": " << latency_.GetValueAtQuantile(0.99)
+        << ", \"p999\": " << latency_.GetValueAtQuantile(0.999)
+        << ", \"max\": " << latency_.GetMax() << "}"
+        << ", \"result_counts\": [";
+    for (size_t i = 0; i < RESULT_COUNT_BUCKETS; ++i) {
+        os << (i == 0 ? "" : ", ") << GetResultCountFrequency(i);
+    }
+    os << "]}";
+}
+
+int64_t RequestStatistics::ToNanoseconds(Clock::time_point time) noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Log-linear (HDR-style) histogram of nanosecond values.
+// Values below 2 * SUB_BUCKET_COUNT are exact, larger ones are kept with ~3% relative error.
+// Record is lock-free: a couple of bit operations and relaxed atomic updates.
+class LatencyHistogram {
+public:
+    inline static constexpr int SUB_BUCKET_BITS = 5;
+    inline static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    // larger values (~18 minutes) are clamped
+    inline static constexpr int MAX_VALUE_BITS = 40;
+    inline static constexpr uint64_t MAX_VALUE = (uint64_t{ 1 } << MAX_VALUE_BITS) - 1;
+    inline static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static constexpr size_t BucketIndex(uint64_t value) noexcept {
+        if (value > MAX_VALUE) {
+            value = MAX_VALUE;
+        }
+        if (value < 2 * SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+#if defined(__GNUC__)
+        const int msb = 63 - __builtin_clzll(value);
+#else
+        int msb = SUB_BUCKET_BITS + 1;
+        while ((value >> (msb + 1)) != 0) {
+            msb++;
+        }
+#endif
+        const int shift = msb - SUB_BUCKET_BITS;
+        return static_cast<size_t>(shift * SUB_BUCKET_COUNT + (value >> shift));
+    }
+
+    // The smallest value that falls into the bucket
+    static constexpr uint64_t BucketLowerBound(size_t index) noexcept {
+        if (index < 2 * SUB_BUCKET_COUNT) {
+            return index;
+        }
+        const uint64_t shift = index / SUB_BUCKET_COUNT - 1;
+        return (index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+    }
+
+    inline void Record(uint64_t value) noexcept {
+        buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t GetCount() const noexcept;
+
+    inline uint64_t GetMax() const noexcept {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    double GetMean() const noexcept;
+
+    // quantile in [0, 1]; returns the lower bound of the bucket holding it
+    uint64_t GetValueAtQuantile(double quantile) const noexcept;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> sum_{ 0 };
+    std::atomic<uint64_t> max_{ 0 };
+};
+
+// Lock-free statistics of search requests: latency percentiles, throughput over a sliding
+// window (a minute by default) and the distribution of result counts. Safe to record from several threads.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // counts above are accumulated in the last bucket
+    inline static constexpr size_t RESULT_COUNT_BUCKETS = 8;
+
+    inline static constexpr std::chrono::seconds DEFAULT_QPS_WINDOW{ 60 };
+
+    // the QPS window is counted in this many steps of window / QPS_BUCKETS
+    inline static constexpr size_t QPS_BUCKETS = 60;
+
+    // qps_window shorter than QPS_BUCKETS nanoseconds throws std::invalid_argument
+    explicit RequestStatistics(Clock::duration qps_window = DEFAULT_QPS_WINDOW);
+
+    void Record(Clock::time_point now, Clock::duration latency, size_t result_count) noexcept;
+
+    inline uint64_t GetRequestCount() const noexcept {
+        return latency_.GetCount();
+    }
+
+    inline const LatencyHistogram& GetLatency() const noexcept {
+        return latency_;
+    }
+
+    inline uint64_t GetResultCountFrequency(size_t result_count) const noexcept {
+        return result_counts_[std::min(result_count, RESULT_COUNT_BUCKETS - 1)].load(std::memory_order_relaxed);
+    }
+
+    // Requests per second over the last window, in whole steps.
+    // Approximate: a request racing with the reset of its step may be lost
+    double GetQps(Clock::time_point now) const noexcept;
+
+    inline Clock::duration GetQpsWindow() const noexcept {
+        return std::chrono::nanoseconds(step_ns_ * static_cast<int64_t>(QPS_BUCKETS));
+    }
+
+    void PrintText(std::ostream&, Clock::time_point now = Clock::now()) const;
+
+    void PrintJson(std::ostream&, Clock::time_point now = Clock::now()) const;
+
+private:
+    struct StepCounter {
+        std::atomic<int64_t> step{ -1 };
+        std::atomic<uint64_t> count{ 0 };
+    };
+
+    int64_t step_ns_;
+
+    LatencyHistogram latency_;
+
+    std::array<std::atomic<uint64_t>, RESULT_COUNT_BUCKETS> result_counts_{};
+
+    std::array<StepCounter, QPS_BUCKETS> steps_;
+
+    std::atomic<int64_t> first_record_ns_{ -1 };
+
+    static int64_t ToNanoseconds(Clock::time_point) noexcept;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+// Fixed-capacity FIFO. All the memory is allocated by the constructor
+template <typename T>
+class RingBuffer {
+    std::vector<T> data_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+
+public:
+    // Throws std::invalid_argument if capacity is 0
+    explicit RingBuffer(size_t capacity) : data_(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("ring buffer capacity must be positive");
+        }
+    }
+
+    inline size_t size() const noexcept {
+        return size_;
+    }
+
+    inline size_t capacity() const noexcept {
+        return data_.size();
+    }
+
+    inline bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    inline bool full() const noexcept {
+        return size_ == data_.size();
+    }
+
+    inline const T& front() const {
+        assert(!empty());
+        return data_[head_];
+    }
+
+    inline const T& back() const {
+        assert(!empty());
+        return data_[(head_ + size_ - 1) % data_.size()];
+    }
+
+    // Requires !full()
+    inline void push_back(const T& value) {
+        assert(!full());
+        data_[(head_ + size_) % data_.size()] = value;
+        size_++;
+    }
+
+    inline void pop_front() {
+        assert(!empty());
+        head_ = (head_ + 1) % data_.size();
+        size_--;
+    }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// Scoring policies of SearchServer::FindTopDocuments.
+//
+//     server.FindTopDocuments<Bm25>("fluffy cat"s);
+//
+// A policy is a type with a nested TermScorer constructed once per query term from the
+// collection statistics and the number of documents containing the term; its call
+// operator scores one posting and is inlined into the loop over the postings.
+
+struct CollectionStatistics {
+    size_t document_count = 0;
+    // in words, stop words excluded
+    double average_length = 0.0;
+};
+
+// Term frequency normalized by the document length times the inverse document frequency
+struct TfIdf {
+    class TermScorer {
+        double inverse_document_freq_;
+
+    public:
+        TermScorer(const CollectionStatistics& collection, size_t document_freq) noexcept
+            : inverse_document_freq_(std::log(collection.document_count * 1.0 / document_freq)) {}
+
+        inline double operator()(double term_freq, int /*document_length*/) const noexcept {
+            return term_freq * inverse_document_freq_;
+        }
+    };
+};
+
+// Okapi BM25 with the non-negative IDF of Lucene
+struct Bm25 {
+    inline static constexpr double K1 = 1.2;
+    inline static constexpr double B = 0.75;
+
+    class TermScorer {
+        double weight_;
+        // the length norm K1 * (1 - B + B * length / average_length) as norm_base_ + norm_slope_ * length
+        double norm_base_;
+        double norm_slope_;
+
+    public:
+        TermScorer(const CollectionStatistics& collection, size_t document_freq) noexcept
+            : weight_((K1 + 1.0) * std::log(1.0 + (collection.document_count - document_freq + 0.5) / (document_freq + 0.5)))
+            , norm_base_(K1 * (1.0 - B))
+            , norm_slope_(collection.average_length > 0.0 ? K1 * B / collection.average_length : 0.0) {}
+
+        // term_freq is normalized by the length as in the index
+        inline double operator()(double term_freq, int document_length) const noexcept {
+            const double count = term_freq * document_length;
+            return weight_ * count / (count + std::fma(norm_slope_, document_length, norm_base_));
+        }
+    };
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+
+// Streams every match of a query in ranking order, chunk_size documents at a time.
+// The first chunk scores the query once and keeps the score of every match, 16 bytes each:
+// the postings are not read again. Chunks are served from a buffer of the best
+// max(REFILL_CHUNKS * chunk_size, MIN_REFILL) scores ranked after the last document returned.
+// A refill is one pass over the scores left with a heap bounded by the buffer, and drops those it took.
+// A change of the index between chunks is seen by the next chunk: it scores the query again
+// and keeps the matches ranked after the last one returned, as with any search-after.
+// For memory bounded by the chunk, call SearchServer::FindDocumentsAfter with a count instead.
+//
+//     SearchCursor cursor(search_server, "cat"s, 1000);
+//     for (std::vector<Document> chunk = cursor.Next(); !chunk.empty(); chunk = cursor.Next()) { ... }
+template <typename Scoring = TfIdf>
+class SearchCursor {
+    // a match, smaller than a Document
+    struct Score {
+        double relevance;
+        int document_id;
+        int rating;
+
+        inline Document ToDocument() const noexcept {
+            return { document_id, relevance, rating };
+        }
+    };
+
+    const SearchServer& search_server_;
+    std::string raw_query_;
+    size_t chunk_size_;
+    DocumentStatus status_;
+    std::optional<RankingKey> last_;
+    // the matches ranked after the buffer, in no order
+    std::vector<Score> scores_;
+    // the next documents to return, the best one last
+    std::vector<Document> buffer_;
+    // of the server when scores_ was filled
+    std::optional<uint64_t> generation_;
+    bool done_ = false;
+
+public:
+    inline static constexpr size_t REFILL_CHUNKS = 8;
+    // so that small chunks don't make a pass over the scores each
+    inline static constexpr size_t MIN_REFILL = 4096;
+
+    SearchCursor(const SearchServer& search_server, std::string raw_query, size_t chunk_size,
+        DocumentStatus status = DocumentStatus::ACTUAL)
+        : search_server_(search_server), raw_query_(std::move(raw_query)), chunk_size_(chunk_size), status_(status) {
+        if (chunk_size == 0) {
+            throw std::invalid_argument("chunk size must be positive");
+        }
+    }
+
+    // The next chunk, shorter at the end, empty once every match is returned
+    std::vector<Document> Next() {
+        if (done_) {
+            return {};
+        }
+        if (generation_ != search_server_.GetGeneration()) {
+            scores_.clear();
+            buffer_.clear();
+            search_server_.ForEachDocumentAfter<Scoring>(raw_query_, status_, last_, [this](const Document& document) {
+                scores_.push_back({ document.relevance, document.id, document.rating });
+                });
+            generation_ = search_server_.GetGeneration();
+        }
+        std::vector<Document> chunk;
+        chunk.reserve(std::min(chunk_size_, buffer_.size() + scores_.size()));
+        while (chunk.size() < chunk_size_ && (!buffer_.empty() || Refill())) {
+            chunk.push_back(buffer_.back());
+            buffer_.pop_back();
+        }
+        if (chunk.size() < chunk_size_) {
+            done_ = true;
+            std::vector<Score>().swap(scores_);
+            std::vector<Document>().swap(buffer_);
+        }
+        if (!chunk.empty()) {
+            last_ = RankingKey::Of(chunk.back());
+        }
+        return chunk;
+    }
+
+    inline bool IsDone() const noexcept {
+        return done_;
+    }
+
+private:
+    // Moves the best scores to the buffer; false if none is left
+    bool Refill() {
+        if (scores_.empty()) {
+            return false;
+        }
+        const size_t count = std::max(REFILL_CHUNKS * chunk_size_, MIN_REFILL);
+
+        // a heap of the best count scores, the worst one on top
+        buffer_.reserve(std::min(count, scores_.size()));
+        for (const Score& score : scores_) {
+            const Document document = score.ToDocument();
+            if (buffer_.size() < count) {
+                buffer_.push_back(document);
+                std::push_heap(buffer_.begin(), buffer_.end(), RanksBefore);
+            }
+            else if (RanksBefore(document, buffer_.front())) {
+                std::pop_heap(buffer_.begin(), buffer_.end(), RanksBefore);
+                buffer_.back() = document;
+                std::push_heap(buffer_.begin(), buffer_.end(), RanksBefore);
+            }
+        }
+
+        // the scores left rank after the worst one of the buffer
+        const RankingKey worst = RankingKey::Of(buffer_.front());
+        std::erase_if(scores_, [&worst](const Score& score) {
+            return !(worst < RankingKey::Of(score.ToDocument()));
+            });
+        std::sort_heap(buffer_.begin(), buffer_.end(), RanksBefore);
+        std::reverse(buffer_.begin(), buffer_.end());
+        return true;
+    }
+};
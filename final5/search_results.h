@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "document.h"
+#include "paginator.h"
+#include "ranking_key.h"
+
+// Every match of a query, ordered by RankingKey only as far as it is read.
+// Reading ranks in place, so an instance must not be shared between threads.
+//
+//     const SearchResults results = search_server.FindDocuments("cat"s);
+//     for (const Document& document : results.Page(3, 10)) { ... }
+//     for (const auto page : Paginate(results, 10)) { ... }
+class SearchResults {
+public:
+    // Forward iterator ranking the documents up to the one it points to
+    class Iterator {
+        const SearchResults* results_ = nullptr;
+        size_t index_ = 0;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator() = default;
+
+        Iterator(const SearchResults* results, size_t index) noexcept : results_(results), index_(index) {}
+
+        const Document& operator*() const {
+            // twice as far as needed: reading one by one ranks O(log N) times
+            results_->RankUpTo(std::max(index_ + 1, results_->ranked_ * 2));
+            return results_->documents_[index_];
+        }
+
+        const Document* operator->() const {
+            return &**this;
+        }
+
+        Iterator& operator++() noexcept {
+            ++index_;
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+            Iterator previous = *this;
+            ++index_;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const noexcept {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const noexcept {
+            return index_ != other.index_;
+        }
+    };
+
+    explicit SearchResults(std::vector<Document> documents) noexcept : documents_(std::move(documents)) {}
+
+    inline size_t GetSize() const noexcept {
+        return documents_.size();
+    }
+
+    // How many of the best documents are in their final order
+    inline size_t GetRankedCount() const noexcept {
+        return ranked_;
+    }
+
+    Iterator begin() const noexcept {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const noexcept {
+        return Iterator(this, documents_.size());
+    }
+
+    // Ranks the documents up to the end of the page only; empty past the last page
+    IteratorRange<std::vector<Document>::const_iterator> Page(size_t index, size_t page_size) const {
+        const size_t page_begin = std::min(index * page_size, documents_.size());
+        const size_t page_end = std::min(page_begin + page_size, documents_.size());
+        RankUpTo(page_end);
+        return { documents_.cbegin() + page_begin, documents_.cbegin() + page_end };
+    }
+
+private:
+    mutable std::vector<Document> documents_;
+    // documents_[0, ranked_) are the best ones in order, the rest are worse
+    mutable size_t ranked_ = 0;
+
+    void RankUpTo(size_t count) const {
+        count = std::min(count, documents_.size());
+        if (count <= ranked_) {
+            return;
+        }
+        const auto first = documents_.begin() + ranked_;
+        const auto last = documents_.begin() + count;
+        // linear selection of the next best ones, then a sort of them only
+        std::nth_element(first, last - 1, documents_.end(), RanksBefore);
+        std::sort(first, last, RanksBefore);
+        ranked_ = count;
+    }
+};
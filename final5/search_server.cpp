@@ -1,108 +1,496 @@
 #include "search_server.h"
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text)) {}
+SearchServer::SearchServer(const std::string& stop_words_text, IndexAllocation allocation, ForwardIndex forward_index)
+    : SearchServer(stop_words_text, TokenizerOptions(), allocation, forward_index) {}
 
-void SearchServer::AddDocument(int document_id, const std::string& document, DocumentStatus status,
+SearchServer::SearchServer(const std::string& stop_words_text, TokenizerOptions tokenizer_options, IndexAllocation allocation,
+    ForwardIndex forward_index)
+    : SearchServer(SplitStopWords(stop_words_text, tokenizer_options), tokenizer_options, allocation, forward_index) {}
+
+SearchServer& SearchServer::operator=(SearchServer&& other) noexcept {
+    // The containers can't take over the memory of other, they are rebuilt around it
+    if (this != &other) {
+        std::destroy_at(this);
+        std::construct_at(this, std::move(other));
+    }
+    return *this;
+}
+
+bool SearchServer::AddDocument(int document_id, const std::string& document, DocumentStatus status,
     const std::vector<int>& ratings) {
+    PROFILE_SCOPE("AddDocument");
     if ((document_id < 0)) {
         throw std::invalid_argument("ID can't be less than zero"s);
     }
     if (documents_.count(document_id) > 0) {
         throw std::invalid_argument("ID already exists"s);
     }
-    std::vector<std::string> words;
-    if (!SplitIntoWordsNoStop(document, words)) {
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    std::pmr::vector<std::string_view> words(&arena);
+    if (!SplitIntoWordsNoStop(document, words, &arena)) {
         throw std::invalid_argument("invalid character(s) in word"s);
     }
 
     const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-       //word_to_document_freqs_[word][document_id] += inv_word_count;
-       doc_to_word_freqs_[document_id][word] += inv_word_count;
+    // without the forward index the frequencies are only needed here
+    WordFrequencies arena_word_freqs(&arena);
+    WordFrequencies& word_freqs = forward_index_ == ForwardIndex::FULL ? doc_to_word_freqs_[document_id] : arena_word_freqs;
+    for (const std::string_view word : words) {
+       // the key is built in the memory of the index, so that the node takes it over
+       word_freqs[WordFrequencies::key_type(word, word_freqs.get_allocator())] += inv_word_count;
+    }
+    const uint32_t slot = static_cast<uint32_t>(slots_.size());
+    if (deduplication_ != Deduplication::OFF) {
+        // the words of the map are sorted, as the signature wants them
+        WordSetSignature signature;
+        for (const auto& [word, term_freq] : word_freqs) {
+            signature.Add(word);
+        }
+        const uint64_t key = signature.Get();
+        const std::optional<uint32_t> original = FindWordSet(key, word_freqs);
+        if (original && deduplication_ == Deduplication::REJECT) {
+            doc_to_word_freqs_.erase(document_id);
+            return false;
+        }
+        slot_signatures_.push_back({ key, static_cast<uint32_t>(word_freqs.size()) });
+        if (original || signatures_.count(key) == 0) {
+            signatures_.emplace(key, slot);
+        }
+    }
+    for (const auto& [word, term_freq] : word_freqs) {
+        auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end()) {
+            postings = word_to_document_freqs_.try_emplace(
+                std::pmr::string(word, word_to_document_freqs_.get_allocator()),
+                memory_->GetResource(IndexCategory::POSTINGS)).first;
+        }
+        // slots only grow, the postings stay sorted
+        postings->second.slots.push_back(slot);
+        postings->second.term_freqs.push_back(term_freq);
     }
 
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    const int rating = ComputeAverageRating(ratings);
+    slots_.push_back({ document_id, rating, status, static_cast<int>(words.size()) });
+    documents_.emplace(document_id, slot);
+    status_bitmaps_[static_cast<size_t>(status)].Set(slot);
+    rating_index_.emplace(rating, slot);
+    total_length_ += words.size();
     document_id_.emplace(document_id);
+    generation_++;
+    return true;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status) const {
+std::string SearchServer::GetQueryKey(const std::string& raw_query) const {
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
 
-    return FindTopDocuments(
-        raw_query,
-        [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    Query query(&arena);
+    if (!ParseQuery(raw_query, query)) {
+        throw std::invalid_argument("invalid request");
+    }
+    return MakeQueryKey(query);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+std::string SearchServer::MakeQueryKey(const Query& query) const {
+    std::string key;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        key += query.plus_words[i];
+        if (query.plus_distances[i] > 0) {
+            key += '~';
+            key += static_cast<char>('0' + query.plus_distances[i]);
+        }
+        key += ' ';
+    }
+    for (const std::string_view word : query.minus_words) {
+        key += '-';
+        key += word;
+        key += ' ';
+    }
+    return key;
 }
 
 std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument(const std::string& raw_query, int document_id) const {
+    PROFILE_SCOPE("MatchDocument");
 
-    Query query;
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    Query query(&arena);
     if (!ParseQuery(raw_query, query)) {
         throw std::invalid_argument("invalid request");
     }
+    const uint32_t slot = documents_.at(document_id);
     std::vector<std::string> matched_words;
-    for (const std::string& word : query.plus_words) {
-
-        if (doc_to_word_freqs_.at(document_id).count(word)) {
-            matched_words.push_back(word);
+    for (const std::string_view word : query.plus_words) {
+        if (HasWord(word, slot)) {
+            matched_words.emplace_back(word);
         }
-        
     }
-    for (const std::string& word : query.minus_words) {
-        
-        if (doc_to_word_freqs_.at(document_id).count(word)) {
+    for (const std::string_view word : query.minus_words) {
+        if (HasWord(word, slot)) {
             matched_words.clear();
             break;
         }
-        
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, slots_[slot].status };
+}
+
+[[nodiscard]] bool SearchServer::HasWord(std::string_view word, uint32_t slot) const {
+    const auto postings = word_to_document_freqs_.find(word);
+    return postings != word_to_document_freqs_.end()
+        && std::binary_search(postings->second.slots.begin(), postings->second.slots.end(), slot);
 }
 
 //O(log N)
-const std::map<std::string, double>& SearchServer::GetWordFrequencies(const int document_id) const noexcept {
-    //binary_search  
-    /*
-    if (doc_to_word_freqs_.count(document_id)) {
-        return doc_to_word_freqs_.at(document_id);
-    }    
-    */
-    const std::map<int, std::map<std::string, double>>::const_iterator it = 
-        std::find_if(doc_to_word_freqs_.begin(), doc_to_word_freqs_.end(), [document_id](const std::pair<int, std::map<std::string, double>>& doc) 
-        {
-            return doc.first == document_id;
-        });
-    
-    if (it != doc_to_word_freqs_.end())
-        return it->second;
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(const int document_id) const noexcept {
+    // shared by every unknown id: the reference must outlive the call, and a map per call would leak
+    static const WordFrequencies empty;
 
-    const std::map<std::string, double>* empty = new std::map<std::string, double>;
+    const auto it = doc_to_word_freqs_.find(document_id);
+    if (it != doc_to_word_freqs_.end()) {
+        return it->second;
+    }
+    return empty;
+}
 
-    return *empty;
+IndexMemoryStats SearchServer::MemoryStats() const noexcept {
+    IndexMemoryStats stats;
+    stats.term_dictionary = memory_->GetCategory(IndexCategory::TERM_DICTIONARY).GetBytesInUse();
+    stats.postings = memory_->GetCategory(IndexCategory::POSTINGS).GetBytesInUse();
+    stats.forward_index = memory_->GetCategory(IndexCategory::FORWARD_INDEX).GetBytesInUse();
+    stats.document_metadata = memory_->GetCategory(IndexCategory::DOCUMENT_METADATA).GetBytesInUse();
+    stats.stop_words = stop_words_.GetMemoryUsage();
+    stats.total = stats.term_dictionary + stats.postings + stats.forward_index + stats.document_metadata + stats.stop_words;
+    stats.heap = memory_->GetHeap().GetBytesInUse();
+    stats.peak_heap = memory_->GetHeap().GetPeakBytesInUse();
+    stats.per_document = documents_.empty() ? 0.0 : stats.total * 1.0 / documents_.size();
+    return stats;
 }
 
 //O(W log N)
 void SearchServer::RemoveDocument(const int document_id) {
-    if (doc_to_word_freqs_.count(document_id)) {
+    PROFILE_SCOPE("RemoveDocument");
+    const auto document = documents_.find(document_id);
+    if (document != documents_.end()) {
+        const uint32_t slot = document->second;
+        DocumentData& document_data = slots_[slot];
+
+        if (forward_index_ == ForwardIndex::FULL) {
+            const auto word_freqs = doc_to_word_freqs_.find(document_id);
+            for (const auto& [word, term_freq] : word_freqs->second) {
+                const auto postings = word_to_document_freqs_.find(word);
+                const std::pmr::vector<uint32_t>& slots = postings->second.slots;
+                ErasePosting(postings, std::lower_bound(slots.begin(), slots.end(), slot) - slots.begin());
+            }
+            doc_to_word_freqs_.erase(word_freqs);
+        }
+        else {
+            // the words of the document are unknown: every posting is searched
+            for (auto postings = word_to_document_freqs_.begin(); postings != word_to_document_freqs_.end();) {
+                const std::pmr::vector<uint32_t>& slots = postings->second.slots;
+                const auto position = std::lower_bound(slots.begin(), slots.end(), slot);
+                const auto next = std::next(postings);
+                if (position != slots.end() && *position == slot) {
+                    ErasePosting(postings, position - slots.begin());
+                }
+                postings = next;
+            }
+        }
+
+        if (deduplication_ != Deduplication::OFF) {
+            auto [signed_slot, end] = signatures_.equal_range(slot_signatures_[slot].signature);
+            for (; signed_slot != end && signed_slot->second != slot; ++signed_slot) {
+            }
+            if (signed_slot != end) {
+                signatures_.erase(signed_slot);
+            }
+        }
+
+        status_bitmaps_[static_cast<size_t>(document_data.status)].Reset(slot);
+        rating_index_.erase({ document_data.rating, slot });
+        total_length_ -= document_data.length;
+        document_data.document_id = INVALID_DOCUMENT_ID;
+        documents_.erase(document);
+
+        document_id_.erase(document_id);
+        generation_++;
+
+        if (documents_.empty()) {
+            ReleaseSlots();
+        }
+        else if (slots_.size() >= MIN_COMPACTED_SLOTS && documents_.size() * 2 < slots_.size()) {
+            CompactSlots();
+        }
+    }
+}
+
+void SearchServer::Clear() {
+    PROFILE_SCOPE("Clear");
+    word_to_document_freqs_.clear();
+    doc_to_word_freqs_.clear();
+    documents_.clear();
+    rating_index_.clear();
+    document_id_.clear();
+    total_length_ = 0;
+    generation_++;
+    ReleaseSlots();
+}
+
+void SearchServer::ReleaseSlots() {
+    // every slot is dead: start over, the memory of the vectors goes back too
+    std::pmr::vector<DocumentData>(slots_.get_allocator()).swap(slots_);
+    std::pmr::vector<SlotSignature>(slot_signatures_.get_allocator()).swap(slot_signatures_);
+    decltype(signatures_)(signatures_.get_allocator()).swap(signatures_);
+    for (SlotBitmap& status_bitmap : status_bitmaps_) {
+        status_bitmap.Clear();
+    }
+    memory_->Release();
+}
+
+void SearchServer::CompactSlots() {
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    // old slot -> new slot, for the live ones
+    std::pmr::vector<uint32_t> new_slots(slots_.size(), 0, &arena);
+    std::pmr::vector<DocumentData> slots(slots_.get_allocator());
+    std::pmr::vector<SlotSignature> slot_signatures(slot_signatures_.get_allocator());
+    slots.reserve(documents_.size());
+    slot_signatures.reserve(deduplication_ != Deduplication::OFF ? documents_.size() : 0);
+    for (uint32_t slot = 0; slot < slots_.size(); ++slot) {
+        if (slots_[slot].document_id != INVALID_DOCUMENT_ID) {
+            new_slots[slot] = static_cast<uint32_t>(slots.size());
+            slots.push_back(slots_[slot]);
+            if (deduplication_ != Deduplication::OFF) {
+                slot_signatures.push_back(slot_signatures_[slot]);
+            }
+        }
+    }
+    slots_.swap(slots);
+    slot_signatures_.swap(slot_signatures);
+
+    // only live slots are left in the postings
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        for (uint32_t& slot : postings.slots) {
+            slot = new_slots[slot];
+        }
+    }
+    for (auto& [document_id, slot] : documents_) {
+        slot = new_slots[slot];
+    }
+    for (auto& [signature, slot] : signatures_) {
+        slot = new_slots[slot];
+    }
+    // the order is kept, so the set is rebuilt from its end
+    decltype(rating_index_) rating_index(rating_index_.get_allocator());
+    for (const auto& [rating, slot] : rating_index_) {
+        rating_index.emplace_hint(rating_index.end(), rating, new_slots[slot]);
+    }
+    rating_index_.swap(rating_index);
+    for (SlotBitmap& status_bitmap : status_bitmaps_) {
+        status_bitmap.Clear();
+    }
+    for (uint32_t slot = 0; slot < slots_.size(); ++slot) {
+        status_bitmaps_[static_cast<size_t>(slots_[slot].status)].Set(slot);
+    }
+}
+
+void SearchServer::ErasePosting(std::pmr::map<std::pmr::string, Postings, std::less<>>::iterator postings, size_t position) {
+    if (postings->second.size() == 1) {
+        word_to_document_freqs_.erase(postings);
+        return;
+    }
+    std::pmr::vector<uint32_t>& slots = postings->second.slots;
+    slots.erase(slots.begin() + position);
+    postings->second.term_freqs.erase(postings->second.term_freqs.begin() + position);
+}
+
+[[nodiscard]] bool SearchServer::HasWordSet(uint32_t slot, const WordFrequencies& words) const {
+    if (slot_signatures_[slot].word_count != words.size()) {
+        return false;
+    }
+    return std::all_of(words.begin(), words.end(), [this, slot](const auto& word_freq) {
+        return HasWord(word_freq.first, slot);
+        });
+}
+
+std::optional<uint32_t> SearchServer::FindWordSet(uint64_t signature, const WordFrequencies& words) const {
+    // every slot under a signature has the same words: the first one decides
+    const auto signed_slot = signatures_.find(signature);
+    if (signed_slot != signatures_.end() && HasWordSet(signed_slot->second, words)) {
+        return signed_slot->second;
+    }
+    return std::nullopt;
+}
+
+void SearchServer::SetDeduplication(Deduplication deduplication) {
+    if (deduplication == Deduplication::OFF) {
+        std::pmr::vector<SlotSignature>(slot_signatures_.get_allocator()).swap(slot_signatures_);
+        decltype(signatures_)(signatures_.get_allocator()).swap(signatures_);
+    }
+    else if (deduplication_ == Deduplication::OFF) {
+        QueryArena& arena = QueryArena::ForThisThread();
+        QueryArena::Scope arena_scope(arena);
 
-        doc_to_word_freqs_.erase(document_id);
+        std::pmr::vector<WordSetSignature> signatures(&arena);
+        SignSlots(signatures);
+        slot_signatures_.reserve(slots_.size());
+        for (uint32_t slot = 0; slot < slots_.size(); ++slot) {
+            slot_signatures_.push_back({ signatures[slot].Get(), static_cast<uint32_t>(signatures[slot].GetSize()) });
+            if (slots_[slot].document_id != INVALID_DOCUMENT_ID) {
+                signatures_.emplace(slot_signatures_[slot].signature, slot);
+            }
+        }
 
-        documents_.erase(document_id);
+        // the words of the slots sharing a signature are collected in one more pass and compared
+        SlotBitmap shared(slots_.size(), &arena);
+        bool is_shared = false;
+        for (auto group = signatures_.begin(); group != signatures_.end(); ++group) {
+            const auto next = std::next(group);
+            if (next != signatures_.end() && next->first == group->first) {
+                shared.Set(group->second);
+                shared.Set(next->second);
+                is_shared = true;
+            }
+        }
+        if (is_shared) {
+            std::pmr::vector<std::pmr::vector<std::string_view>> words(slots_.size(), &arena);
+            for (const auto& [word, postings] : word_to_document_freqs_) {
+                for (const uint32_t slot : postings.slots) {
+                    if (shared.Test(slot)) {
+                        words[slot].push_back(word);
+                    }
+                }
+            }
+            // a slot with other words than the first one of its signature collided: it is left out
+            for (auto group = signatures_.begin(); group != signatures_.end();) {
+                const uint32_t first = group->second;
+                auto slot = std::next(group);
+                for (; slot != signatures_.end() && slot->first == group->first;) {
+                    slot = words[slot->second] == words[first] ? std::next(slot) : signatures_.erase(slot);
+                }
+                group = slot;
+            }
+        }
+    }
+    deduplication_ = deduplication;
+}
 
-        auto it = std::lower_bound(document_id_.begin(), document_id_.end(), document_id);
-        document_id_.erase(it);    
+void SearchServer::SignSlots(std::pmr::vector<WordSetSignature>& signatures) const {
+    signatures.assign(slots_.size(), WordSetSignature());
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        for (const uint32_t slot : postings.slots) {
+            signatures[slot].Add(word);
+        }
     }
 }
 
-bool SearchServer::IsValidWord(const std::string& word) {
+std::vector<SearchServer::DocumentSignature> SearchServer::GetSignatures() const {
+    std::vector<DocumentSignature> signatures;
+    signatures.reserve(documents_.size());
+    if (deduplication_ != Deduplication::OFF) {
+        for (const auto& [document_id, slot] : documents_) {
+            signatures.push_back({ document_id, slot_signatures_[slot].signature, slot_signatures_[slot].word_count });
+        }
+        return signatures;
+    }
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    std::pmr::vector<WordSetSignature> slot_signatures(&arena);
+    SignSlots(slot_signatures);
+    for (const auto& [document_id, slot] : documents_) {
+        signatures.push_back({ document_id, slot_signatures[slot].Get(), static_cast<uint32_t>(slot_signatures[slot].GetSize()) });
+    }
+    return signatures;
+}
+
+std::vector<std::vector<std::string_view>> SearchServer::GetWords(const std::vector<int>& document_ids) const {
+    std::vector<std::vector<std::string_view>> words(document_ids.size());
+    if (forward_index_ == ForwardIndex::FULL) {
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            for (const auto& [word, term_freq] : doc_to_word_freqs_.at(document_ids[i])) {
+                words[i].push_back(word);
+            }
+        }
+        return words;
+    }
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    // slot -> position in document_ids, or -1
+    std::pmr::vector<int> positions(slots_.size(), -1, &arena);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        positions[documents_.at(document_ids[i])] = static_cast<int>(i);
+    }
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        for (const uint32_t slot : postings.slots) {
+            if (positions[slot] >= 0) {
+                words[positions[slot]].push_back(word);
+            }
+        }
+    }
+    return words;
+}
+
+std::vector<int> SearchServer::GetDuplicates() const {
+    std::vector<int> duplicates;
+    // the slots of a signature are next to each other
+    for (auto group = signatures_.begin(); group != signatures_.end();) {
+        auto group_end = std::next(group);
+        int original = slots_[group->second].document_id;
+        for (; group_end != signatures_.end() && group_end->first == group->first; ++group_end) {
+            const int document_id = slots_[group_end->second].document_id;
+            duplicates.push_back(std::max(original, document_id));
+            original = std::min(original, document_id);
+        }
+        group = group_end;
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+void SearchServer::DropForwardIndex() noexcept {
+    forward_index_ = ForwardIndex::NONE;
+    doc_to_word_freqs_.clear();
+}
+
+std::vector<double>& SearchServer::GetDenseScores(size_t slot_count) {
+    thread_local std::vector<double> scores;
+    if (scores.size() < slot_count) {
+        scores.resize(slot_count, 0.0);
+    }
+    return scores;
+}
+
+void SearchServer::FilterByRating(SlotBitmap& candidates, RatingRange ratings, std::pmr::memory_resource* resource) const {
+    const size_t candidate_count = candidates.Count();
+
+    SlotBitmap in_range(candidates.GetSize(), resource);
+    size_t range_size = 0;
+    const auto last = rating_index_.upper_bound({ ratings.max_rating, UINT32_MAX });
+    for (auto it = rating_index_.lower_bound({ ratings.min_rating, 0 }); it != last; ++it) {
+        if (++range_size > candidate_count) {
+            // the range is wider than the candidates: check their ratings instead
+            candidates.ForEach([this, &candidates, ratings](size_t slot) {
+                const int rating = slots_[slot].rating;
+                if (rating < ratings.min_rating || rating > ratings.max_rating) {
+                    candidates.Reset(slot);
+                }
+                });
+            return;
+        }
+        in_range.Set(it->second);
+    }
+    candidates.And(in_range);
+}
+
+bool SearchServer::IsValidWord(std::string_view word) {
     // A valid word must not contain special characters
-    return none_of(word.begin(), word.end(), [](char c) {
+    return std::none_of(word.begin(), word.end(), [](char c) {
         return c >= '\0' && c < ' ';
         });
 }
@@ -118,22 +506,31 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-[[nodiscard]] bool SearchServer::SplitIntoWordsNoStop(const std::string& text, std::vector<std::string>& result) const {
-    result.clear();
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            return false;
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+[[nodiscard]] bool SearchServer::SplitIntoWordsNoStop(const std::string& text, std::pmr::vector<std::string_view>& result,
+    std::pmr::memory_resource* resource) const {
+    if (!tokenizer_.Split(text, result, resource)) {
+        result.clear();
+        return false;
     }
-    result.swap(words);
+    result.erase(std::remove_if(result.begin(), result.end(), [this](std::string_view word) {
+        return IsStopWord(word);
+        }), result.end());
     return true;
 }
 
-[[nodiscard]] bool SearchServer::ParseQueryWord(std::string text, QueryWord& result) const {
+std::vector<std::string> SearchServer::SplitStopWords(const std::string& text, const TokenizerOptions& tokenizer_options) {
+    // no case folding yet: the constructor folds the stop words
+    TokenizerOptions options = tokenizer_options;
+    options.fold_case = false;
+
+    std::pmr::vector<std::string_view> words;
+    if (!Tokenizer(std::move(options)).Split(text, words, std::pmr::get_default_resource())) {
+        throw std::invalid_argument("invalid stop-words in constructor"s);
+    }
+    return std::vector<std::string>(words.begin(), words.end());
+}
+
+[[nodiscard]] bool SearchServer::ParseQueryWord(std::string_view text, QueryWord& result) const {
     // Empty result by initializing it with default constructed QueryWord
     result = {};
 
@@ -143,44 +540,209 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
-        text = text.substr(1);
+        text.remove_prefix(1);
     }
 
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    // control characters are rejected by the tokenizer
+    if (text.empty() || text[0] == '-') {
         return false;
     }
 
-    result = QueryWord{ text, is_minus, IsStopWord(text) };
+    uint8_t fuzzy_distance = 0;
+    if (query_syntax_.fuzzy && text.back() == '~') {
+        fuzzy_distance = MAX_FUZZY_DISTANCE;
+        text.remove_suffix(1);
+    }
+    else if (query_syntax_.fuzzy && text.size() >= 2 && text[text.size() - 2] == '~'
+        && text.back() >= '0' && text.back() <= '9') {
+        // a digit makes a distance suffix; a~b is a literal word
+        if (text.back() < '1' || text.back() > '0' + MAX_FUZZY_DISTANCE) {
+            return false;
+        }
+        fuzzy_distance = static_cast<uint8_t>(text.back() - '0');
+        text.remove_suffix(2);
+    }
+
+    // a pattern needs a literal prefix: it bounds the words to try
+    const size_t wildcard = query_syntax_.patterns ? text.find_first_of("*?"sv) : std::string_view::npos;
+    if (text.empty() || wildcard == 0 || (wildcard != std::string_view::npos && fuzzy_distance > 0)) {
+        return false;
+    }
+
+    result = QueryWord{ text, is_minus, IsStopWord(text), wildcard != std::string_view::npos, fuzzy_distance };
     return true;
 }
 
+void SearchServer::ExpandPattern(std::string_view pattern, Expansions& words) const {
+    const std::string_view prefix = pattern.substr(0, pattern.find_first_of("*?"sv));
+    // "pet*": every word of the range matches
+    const bool is_prefix = prefix.size() + 1 == pattern.size() && pattern.back() == '*';
+
+    size_t expansions = 0;
+    size_t scanned = 0;
+    for (auto it = word_to_document_freqs_.lower_bound(prefix);
+        it != word_to_document_freqs_.end() && expansions < MAX_PATTERN_EXPANSIONS && scanned < MAX_PATTERN_SCAN;
+        ++it, ++scanned) {
+        const std::string_view word = it->first;
+        if (word.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        if (is_prefix || MatchesPattern(word, pattern)) {
+            words.emplace_back(word, 0);
+            ++expansions;
+        }
+    }
+}
+
+// The rows of the Levenshtein table of the word against a path in the sorted dictionary are
+// the states of its Levenshtein automaton. A row with no cell within max_distance is a dead state:
+// no word under that prefix can match, so the walk seeks past all of them at once
+void SearchServer::ExpandFuzzy(std::string_view word, uint8_t max_distance, Expansions& words,
+    std::pmr::memory_resource* resource) const {
+    const size_t width = word.size() + 1;
+    // row d is the distance of the first d bytes of the path to every prefix of the word
+    std::pmr::vector<uint32_t> rows(resource);
+    rows.resize(width);
+    for (size_t j = 0; j < width; ++j) {
+        rows[j] = static_cast<uint32_t>(j);
+    }
+    std::pmr::string path(resource);
+    std::pmr::string successor(resource);
+    const size_t first = words.size();
+
+    auto it = word_to_document_freqs_.begin();
+    while (it != word_to_document_freqs_.end()) {
+        const std::string_view term = it->first;
+        // the rows of the common prefix with the path are already known
+        size_t depth = std::mismatch(term.begin(), term.begin() + std::min(term.size(), path.size()), path.begin()).first - term.begin();
+        bool is_dead = false;
+        for (; depth < term.size(); ++depth) {
+            path.resize(depth);
+            path.push_back(term[depth]);
+            rows.resize((depth + 2) * width);
+            const uint32_t* const previous = rows.data() + depth * width;
+            uint32_t* const row = rows.data() + (depth + 1) * width;
+            row[0] = previous[0] + 1;
+            uint32_t row_min = row[0];
+            for (size_t j = 1; j < width; ++j) {
+                const uint32_t substitution = previous[j - 1] + (word[j - 1] == term[depth] ? 0 : 1);
+                row[j] = std::min({ previous[j] + 1, row[j - 1] + 1, substitution });
+                row_min = std::min(row_min, row[j]);
+            }
+            if (row_min > max_distance) {
+                is_dead = true;
+                break;
+            }
+        }
+        if (is_dead) {
+            // the first word after every one starting with path
+            successor = path;
+            while (!successor.empty() && static_cast<unsigned char>(successor.back()) == 0xFF) {
+                successor.pop_back();
+            }
+            if (successor.empty()) {
+                break;
+            }
+            successor.back() = static_cast<char>(static_cast<unsigned char>(successor.back()) + 1);
+            it = word_to_document_freqs_.lower_bound(std::string_view(successor));
+            continue;
+        }
+        path.resize(term.size());
+        const uint32_t distance = rows[term.size() * width + word.size()];
+        if (distance <= max_distance) {
+            words.emplace_back(term, static_cast<uint8_t>(distance));
+        }
+        ++it;
+    }
+
+    // the closest ones, in dictionary order among equally close
+    if (words.size() - first > MAX_FUZZY_EXPANSIONS) {
+        std::stable_sort(words.begin() + first, words.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second < rhs.second;
+            });
+        words.resize(first + MAX_FUZZY_EXPANSIONS);
+    }
+}
+
+bool SearchServer::MatchesPattern(std::string_view word, std::string_view pattern) noexcept {
+    // greedy matching, going back to the last '*' on a mismatch
+    size_t w = 0;
+    size_t p = 0;
+    size_t star = std::string_view::npos;
+    size_t star_w = 0;
+    while (w < word.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == word[w])) {
+            ++w;
+            ++p;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_w = w;
+        }
+        else if (star != std::string_view::npos) {
+            p = star + 1;
+            w = ++star_w;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
 [[nodiscard]] bool SearchServer::ParseQuery(const std::string& text, Query& result) const {
-    // Empty result by initializing it with default constructed Query
-    result = {};
-    for (const std::string& word : SplitIntoWords(text)) {
+    PROFILE_SCOPE("ParseQuery");
+    result.plus_words.clear();
+    result.plus_distances.clear();
+    result.minus_words.clear();
+    std::pmr::memory_resource* const resource = result.plus_words.get_allocator().resource();
+    std::pmr::vector<std::string_view> words(resource);
+    if (!tokenizer_.Split(text, words, resource)) {
+        return false;
+    }
+    Expansions plus_words(resource);
+    Expansions expansions(resource);
+    for (const std::string_view word : words) {
         QueryWord query_word;
         if (!ParseQueryWord(word, query_word)) {
             return false;
         }
-        if (!query_word.is_stop) {
+        if (query_word.is_stop) {
+            continue;
+        }
+        expansions.clear();
+        if (query_word.is_pattern) {
+            ExpandPattern(query_word.data, expansions);
+        }
+        else if (query_word.fuzzy_distance > 0) {
+            ExpandFuzzy(query_word.data, query_word.fuzzy_distance, expansions, resource);
+        }
+        else {
+            expansions.emplace_back(query_word.data, 0);
+        }
+        for (const auto& [expansion, distance] : expansions) {
             if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+                result.minus_words.push_back(expansion);
             }
             else {
-                result.plus_words.insert(query_word.data);
+                plus_words.emplace_back(expansion, distance);
             }
         }
     }
-    return true;
-}
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    int size = 0;
-    for (const auto& [doc, content] : doc_to_word_freqs_) {
-        if (content.count(word)) {
-            size++;
-        }
+    // a word found several times keeps its smallest distance
+    std::sort(plus_words.begin(), plus_words.end());
+    plus_words.erase(std::unique(plus_words.begin(), plus_words.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+        }), plus_words.end());
+    for (const auto& [word, distance] : plus_words) {
+        result.plus_words.push_back(word);
+        result.plus_distances.push_back(distance);
     }
-    return log(GetDocumentCount() * 1.0 / size);
-}
\ No newline at end of file
+    std::sort(result.minus_words.begin(), result.minus_words.end());
+    result.minus_words.erase(std::unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+    return true;
+}
@@ -5,185 +5,761 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
 
 #include "document.h"
+#include "index_memory.h"
 #include "string_processing.h"
-#include "log_duration.h"
+#include "tokenizer.h"
+#include "profiler.h"
+#include "query_arena.h"
+#include "ranking_key.h"
+#include "search_results.h"
+#include "scoring.h"
+#include "slot_bitmap.h"
+#include "stop_word_filter.h"
+#include "word_set_signature.h"
+
+using namespace std::literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// Inclusive bounds of the average rating
+struct RatingRange {
+    int min_rating;
+    int max_rating;
+};
+
+// Query words with a special meaning, all off by default: every byte of a query word is then literal
+struct QuerySyntax {
+    // '*' and '?' in a word make it a pattern, which needs a literal prefix: "pet*", "p?t"
+    bool patterns = false;
+    // a word ending with "~", "~1" or "~2" is fuzzy: "cat~1". Another digit or nothing before '~' is an error;
+    // "~" followed by a non-digit is literal: "a~b"
+    bool fuzzy = false;
+};
+
+enum class ForwardIndex {
+    FULL, // the words of every document: GetWordFrequencies, RemoveDocument in O(W log N)
+    NONE, // for query-only servers: no GetWordFrequencies, RemoveDocument scans the dictionary
+};
+
+// What AddDocument does with a document whose set of words is that of an indexed one
+enum class Deduplication {
+    OFF,    // nothing, and no signatures are kept
+    REJECT, // leaves it out: the first one added stays
+    RECORD, // adds it; GetDuplicates lists it
+};
+
 class SearchServer {
+public:
+    struct DocumentSignature {
+        int document_id;
+        // of the set of words, see WordSetSignature
+        uint64_t signature;
+        uint32_t word_count;
+    };
+
+    // std::less<> allows lookups by std::string_view
+    using WordFrequencies = std::pmr::map<std::pmr::string, double, std::less<>>;
 
+    // With QuerySyntax::patterns, a query word with '*' (any bytes) or '?' (one byte) is a pattern: it stands for
+    // at most MAX_PATTERN_EXPANSIONS indexed words, the first ones in dictionary order
+    inline static constexpr size_t MAX_PATTERN_EXPANSIONS = 64;
+    // Indexed words tried against one pattern; those sharing its literal prefix only
+    inline static constexpr size_t MAX_PATTERN_SCAN = 1 << 14;
+
+    // With QuerySyntax::fuzzy, a query word ending with "~1" or "~2" ("~" alone means 2) also matches the indexed words
+    // within that edit distance, at most MAX_FUZZY_EXPANSIONS of the closest ones.
+    // Every edit multiplies the score of a variant by FUZZY_DISCOUNT
+    inline static constexpr uint8_t MAX_FUZZY_DISTANCE = 2;
+    inline static constexpr size_t MAX_FUZZY_EXPANSIONS = 64;
+    inline static constexpr double FUZZY_DISCOUNT = 0.5;
+
+private:
+    // Documents live in internal slots numbered in the order they are added.
+    // A removed document leaves INVALID_DOCUMENT_ID in its slot until CompactSlots renumbers the live ones
     struct DocumentData {
+        int document_id;
         int rating;
         DocumentStatus status;
+        // in words, stop words excluded
+        int length;
     };
 
+    inline static constexpr size_t STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+
+    // Dead slots are compacted once they outnumber the live ones, in a server of at least this many
+    inline static constexpr size_t MIN_COMPACTED_SLOTS = 64;
+
+    // Slots of the documents containing a word, ascending, with the term frequencies.
+    // Kept as two arrays so that the scoring loops run over contiguous memory
+    // Allocated from the postings resource, not from the dictionary holding them
+    struct Postings {
+        explicit Postings(std::pmr::memory_resource* resource) : slots(resource), term_freqs(resource) {}
+
+        inline size_t size() const noexcept {
+            return slots.size();
+        }
+
+        std::pmr::vector<uint32_t> slots;
+        std::pmr::vector<double> term_freqs;
+    };
+
+    // Scores go to a dense array when at least 1 / DENSE_SCORES_RATIO of the postings
+    // of the plus words belong to candidates, to a sorted sparse buffer otherwise
+    inline static constexpr size_t DENSE_SCORES_RATIO = 4;
+
     struct QueryWord {
-        std::string data;
+        std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_pattern;
+        // 0 if not fuzzy
+        uint8_t fuzzy_distance;
     };
 
+    struct SlotSignature {
+        uint64_t signature;
+        uint32_t word_count;
+    };
+
+    // Indexed words a pattern or a fuzzy word stands for, with their edit distances
+    using Expansions = std::pmr::vector<std::pair<std::string_view, uint8_t>>;
+
+    // Words are views of the raw query or, for patterns and fuzzy words, of the index;
+    // sorted and unique, allocated from the QueryArena
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource), plus_distances(resource), minus_words(resource) {}
+
+        std::pmr::vector<std::string_view> plus_words;
+        // edit distance of every plus word from the word of the query, 0 unless fuzzy
+        std::pmr::vector<uint8_t> plus_distances;
+        std::pmr::vector<std::string_view> minus_words;
     };
 
-    std::set<std::string> stop_words_;
+    // Declared first: the containers below are allocated from it.
+    // Owned through a pointer so that moving the server keeps their memory in place
+    std::unique_ptr<IndexMemory> memory_;
+
+    ForwardIndex forward_index_;
+
+    StopWordFilter stop_words_;
+
+    Tokenizer tokenizer_;
+
+    QuerySyntax query_syntax_;
+
+    std::pmr::map<std::pmr::string, Postings, std::less<>> word_to_document_freqs_;
+
+    // empty with ForwardIndex::NONE
+    std::pmr::map<int, WordFrequencies> doc_to_word_freqs_;
+
+    // document id -> slot
+    std::pmr::map<int, uint32_t> documents_;
 
-    std::map<int, std::map<std::string, double>> doc_to_word_freqs_;
+    std::pmr::vector<DocumentData> slots_;
 
-    std::map<int, DocumentData> documents_;
+    // slots of the documents of every status
+    std::array<SlotBitmap, STATUS_COUNT> status_bitmaps_;
+
+    // (rating, slot) of every document
+    std::pmr::set<std::pair<int, uint32_t>> rating_index_;
     
-    std::set<int> document_id_;
+    std::pmr::set<int> document_id_;
+
+    Deduplication deduplication_ = Deduplication::OFF;
+
+    // per slot while deduplication is on
+    std::pmr::vector<SlotSignature> slot_signatures_;
+
+    // signature -> slots of the documents with that set of words; a document whose signature
+    // collides with another set is not in it
+    std::pmr::unordered_multimap<uint64_t, uint32_t> signatures_;
+
+    // sum of the lengths of the documents
+    uint64_t total_length_ = 0;
+
+    // bumped by every change of the index or of the query syntax, see QueryCache
+    uint64_t generation_ = 0;
 
 public:
     // Defines an invalid document id
     // You can refer this constant as SearchServer::INVALID_DOCUMENT_ID
     inline static constexpr int INVALID_DOCUMENT_ID = -1;
 
+    // IndexAllocation::POOL serves the nodes of the index from pools owned by the server;
+    // they go back to the heap at once when the last document is removed
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer&);
+    explicit SearchServer(const StringContainer&, IndexAllocation = IndexAllocation::HEAP,
+        ForwardIndex = ForwardIndex::FULL);
+
+    // Documents, queries and a text of stop words are split as the options say
+    template <typename StringContainer>
+    SearchServer(const StringContainer&, TokenizerOptions, IndexAllocation = IndexAllocation::HEAP,
+        ForwardIndex = ForwardIndex::FULL);
+
+    explicit SearchServer(const std::string&, IndexAllocation = IndexAllocation::HEAP,
+        ForwardIndex = ForwardIndex::FULL);
+
+    SearchServer(const std::string&, TokenizerOptions, IndexAllocation = IndexAllocation::HEAP,
+        ForwardIndex = ForwardIndex::FULL);
+
+    SearchServer(SearchServer&&) noexcept = default;
 
-    explicit SearchServer(const std::string&);
+    SearchServer& operator=(SearchServer&&) noexcept;
 
-    void AddDocument(int, const std::string&, DocumentStatus, const std::vector<int>&);
+    // False if left out as a duplicate, see Deduplication
+    bool AddDocument(int, const std::string&, DocumentStatus, const std::vector<int>&);
 
     inline int GetDocumentCount() const noexcept{
         return documents_.size();
     }
 
     
-    inline std::set<int>::const_iterator begin() const noexcept {
+    inline uint64_t GetGeneration() const noexcept {
+        return generation_;
+    }
+
+    inline std::pmr::set<int>::const_iterator begin() const noexcept {
         return document_id_.begin();
     }
 
     
-    inline std::set<int>::const_iterator end() const noexcept {
+    inline std::pmr::set<int>::const_iterator end() const noexcept {
         return document_id_.end();
     }
 
-    template <typename DocumentPredicate>
+    // Heap traffic of the index containers
+    inline const IndexMemory& GetIndexMemory() const noexcept {
+        return *memory_;
+    }
+
+    // Bytes of every part of the index, O(1)
+    IndexMemoryStats MemoryStats() const noexcept;
+
+    inline ForwardIndex GetForwardIndex() const noexcept {
+        return forward_index_;
+    }
+
+    // Frees the words of every document, as if built with ForwardIndex::NONE
+    void DropForwardIndex() noexcept;
+
+    inline Deduplication GetDeduplication() const noexcept {
+        return deduplication_;
+    }
+
+    // Signs the indexed documents in O(postings), then every added one in O(W).
+    // Duplicates already indexed are kept, whatever the mode
+    void SetDeduplication(Deduplication);
+
+    // Ids of the documents with the words of a document with a lower id, ascending:
+    // those RemoveDuplicates removes. O(N); empty with Deduplication::OFF
+    std::vector<int> GetDuplicates() const;
+
+    // Of every document, by id; O(N) while deduplication is on, O(postings) otherwise
+    std::vector<DocumentSignature> GetSignatures() const;
+
+    // Sorted words of every document, views of the index; the ids are distinct, an unknown one throws std::out_of_range.
+    // O(W log N) per document with the forward index, a pass over the postings without it
+    std::vector<std::vector<std::string_view>> GetWords(const std::vector<int>& document_ids) const;
+
+    // Scoring is a policy from scoring.h
+    template <typename Scoring = TfIdf, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentPredicate document_predicate) const;
 
+    template <typename Scoring = TfIdf>
     std::vector<Document> FindTopDocuments(const std::string&, DocumentStatus) const;
 
+    // Throws std::invalid_argument if min_rating > max_rating
+    template <typename Scoring = TfIdf>
+    std::vector<Document> FindTopDocuments(const std::string&, DocumentStatus, RatingRange) const;
+
+    template <typename Scoring = TfIdf>
     std::vector<Document> FindTopDocuments(const std::string&) const;
 
+    // Every match, ranked only as far as it is read: see SearchResults
+    template <typename Scoring = TfIdf, typename DocumentPredicate>
+    SearchResults FindDocuments(const std::string& raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename Scoring = TfIdf>
+    SearchResults FindDocuments(const std::string&, DocumentStatus = DocumentStatus::ACTUAL) const;
+
+    // At most count documents ranked right after the key, or the best ones without a key.
+    // Memory is bounded by count, not by the number of matches
+    template <typename Scoring = TfIdf>
+    std::vector<Document> FindDocumentsAfter(const std::string& raw_query, DocumentStatus status,
+        const std::optional<RankingKey>& after, size_t count) const;
+
+    // Every document ranked after the key, or every match without a key, in no particular order
+    template <typename Scoring = TfIdf>
+    std::vector<Document> FindDocumentsAfter(const std::string& raw_query, DocumentStatus status,
+        const std::optional<RankingKey>& after) const;
+
+    // Calls sink(const Document&) for every document FindDocumentsAfter would return, without collecting them; see SearchCursor
+    template <typename Scoring = TfIdf, typename DocumentSink>
+    void ForEachDocumentAfter(const std::string& raw_query, DocumentStatus status,
+        const std::optional<RankingKey>& after, DocumentSink sink) const;
+
+    inline CollectionStatistics GetCollectionStatistics() const noexcept {
+        return { documents_.size(), documents_.empty() ? 0.0 : total_length_ * 1.0 / documents_.size() };
+    }
+
+    inline const QuerySyntax& GetQuerySyntax() const noexcept {
+        return query_syntax_;
+    }
+
+    // Applies to the queries made afterwards; not to be called while queries are running
+    inline void SetQuerySyntax(QuerySyntax query_syntax) noexcept {
+        query_syntax_ = query_syntax;
+        generation_++;
+    }
+
+    // Normalized form of the query: sorted plus words followed by sorted minus words, stop words dropped,
+    // patterns and fuzzy words expanded to the indexed words they match; variants end with "~distance"
+    std::string GetQueryKey(const std::string&) const;
+
+    // FindTopDocuments for caches keyed by GetQueryKey, parsing the query once: cache_lookup(const std::string& key)
+    // is called first, and the result it points to is returned without searching unless it is nullptr
+    template <typename Scoring = TfIdf, typename CacheLookup>
+    std::vector<Document> FindTopDocumentsCached(const std::string&, DocumentStatus, CacheLookup) const;
+
+    template <typename Scoring = TfIdf, typename DocumentPredicate, typename CacheLookup>
+    std::vector<Document> FindTopDocumentsCached(const std::string& raw_query, DocumentPredicate document_predicate,
+        CacheLookup cache_lookup) const;
+
+    // Looks the words up in the postings, so works without the forward index
     std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string&, int) const;
 
-    //O(log N)
-    const std::map<std::string, double>& GetWordFrequencies(const int) const noexcept;
+    //O(log N); empty with ForwardIndex::NONE or for an unknown id, without allocating
+    const WordFrequencies& GetWordFrequencies(const int) const noexcept;
 
-    //O(W log N)
+    //O(W log N); O(V log N) over the whole dictionary with ForwardIndex::NONE.
+    // Once most slots are dead they are compacted in O(postings), amortized over the removals,
+    // so that the index stays proportional to the live documents under churn
     void RemoveDocument(int document_id);
 
+    // Removes every document at once. The server is the segment of IndexAllocation::POOL:
+    // its chunks go back to the heap together instead of node by node. O(N + postings)
+    void Clear();
+
 private:
+    [[nodiscard]] bool HasWord(std::string_view word, uint32_t slot) const;
+
+    // Signature of every slot; the dictionary is sorted, so every slot receives its words in order
+    void SignSlots(std::pmr::vector<WordSetSignature>& signatures) const;
+
+    // Same words as the slot: the count is compared, then every word looked up in the postings
+    [[nodiscard]] bool HasWordSet(uint32_t slot, const WordFrequencies& words) const;
 
-    static bool IsValidWord(const std::string&);
+    // The signed slot with the same words, if any
+    std::optional<uint32_t> FindWordSet(uint64_t signature, const WordFrequencies& words) const;
+
+    // Removes the slot from the postings of the word, and the word if nothing is left
+    void ErasePosting(std::pmr::map<std::pmr::string, Postings, std::less<>>::iterator postings, size_t position);
+
+    // Renumbers the live slots in their order, so that the postings stay sorted, and frees the dead ones
+    void CompactSlots();
+
+    // Frees what the slots hold once no document is left, then the pool in bulk
+    void ReleaseSlots();
+
+    static bool IsValidWord(std::string_view);
 
     static int ComputeAverageRating(const std::vector<int>&);
 
-    inline bool IsStopWord(const std::string& word) const {
-        return stop_words_.count(word) > 0;
+    inline bool IsStopWord(std::string_view word) const {
+        return stop_words_.Contains(word);
     }
 
-    [[nodiscard]] bool SplitIntoWordsNoStop(const std::string&, std::vector<std::string>&) const;
+    // Words are views of text or of the resource
+    [[nodiscard]] bool SplitIntoWordsNoStop(const std::string&, std::pmr::vector<std::string_view>&,
+        std::pmr::memory_resource*) const;
+
+    static std::vector<std::string> SplitStopWords(const std::string&, const TokenizerOptions&);
+
+    [[nodiscard]] bool ParseQueryWord(std::string_view, QueryWord&) const;
 
-    [[nodiscard]] bool ParseQueryWord(std::string, QueryWord&) const;
+    // Appends the indexed words matching the pattern
+    void ExpandPattern(std::string_view pattern, Expansions& words) const;
+
+    // Appends the indexed words within max_distance edits of the word
+    void ExpandFuzzy(std::string_view word, uint8_t max_distance, Expansions& words, std::pmr::memory_resource*) const;
+
+    static bool MatchesPattern(std::string_view word, std::string_view pattern) noexcept;
 
     [[nodiscard]] bool ParseQuery(const std::string&, Query&) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string&) const;
+    std::string MakeQueryKey(const Query&) const;
+
+    // CandidateFilter is called with the bitmap of the slots matching the query and resets the rejected ones
+    template <typename Scoring, typename CandidateFilter>
+    std::vector<Document> FindTopDocumentsFiltered(const std::string&, CandidateFilter) const;
+
+    template <typename Scoring, typename CandidateFilter, typename CacheLookup>
+    std::vector<Document> FindTopDocumentsCachedFiltered(const std::string&, CandidateFilter, CacheLookup) const;
+
+    template <typename Scoring, typename CandidateFilter>
+    std::vector<Document> FindTopDocuments(const Query&, CandidateFilter, QueryArena&) const;
 
+    template <typename Scoring, typename CandidateFilter>
+    SearchResults FindDocumentsFiltered(const std::string&, CandidateFilter) const;
+
+    // The predicate is called once per candidate
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query&, DocumentPredicate) const;
+    auto MakePredicateFilter(DocumentPredicate& document_predicate) const {
+        return [this, &document_predicate](SlotBitmap& candidates) {
+            candidates.ForEach([this, &document_predicate, &candidates](size_t slot) {
+                const DocumentData& document_data = slots_[slot];
+                if (!document_predicate(document_data.document_id, document_data.status, document_data.rating)) {
+                    candidates.Reset(slot);
+                }
+                });
+            };
+    }
+
+    // A word-wide AND with the bitmap of the status
+    inline auto MakeStatusFilter(DocumentStatus status) const {
+        return [this, status](SlotBitmap& candidates) {
+            candidates.And(status_bitmaps_[static_cast<size_t>(status)]);
+            };
+    }
+
+    template <typename Scoring, typename CandidateFilter>
+    std::pmr::vector<Document> FindAllDocuments(const Query&, CandidateFilter, std::pmr::memory_resource*) const;
+
+    // Calls sink(const Document&) for every match, in no particular order
+    template <typename Scoring, typename CandidateFilter, typename DocumentSink>
+    void ForEachMatch(const Query&, CandidateFilter, std::pmr::memory_resource*, DocumentSink) const;
+
+    // Scratch array of this thread with at least slot_count zeroes; whoever adds to it resets it
+    static std::vector<double>& GetDenseScores(size_t slot_count);
+
+    // Uses the rating index when the range holds fewer documents than the candidates; min_rating <= max_rating
+    void FilterByRating(SlotBitmap& candidates, RatingRange, std::pmr::memory_resource*) const;
 
     template <typename StringContainer>
     void CheckValidity(const StringContainer&);
 
     template <typename StringContainer>
-    std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer&);
+    std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer&);
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words) {
+SearchServer::SearchServer(const StringContainer& stop_words, IndexAllocation allocation, ForwardIndex forward_index)
+    : SearchServer(stop_words, TokenizerOptions(), allocation, forward_index) {}
+
+template <typename StringContainer>
+SearchServer::SearchServer(const StringContainer& stop_words, TokenizerOptions tokenizer_options, IndexAllocation allocation,
+    ForwardIndex forward_index)
+    : memory_(std::make_unique<IndexMemory>(allocation)),
+    forward_index_(forward_index),
+    tokenizer_(std::move(tokenizer_options)),
+    word_to_document_freqs_(memory_->GetResource(IndexCategory::TERM_DICTIONARY)),
+    doc_to_word_freqs_(memory_->GetResource(IndexCategory::FORWARD_INDEX)),
+    documents_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+    slots_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+    status_bitmaps_{ SlotBitmap(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+        SlotBitmap(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+        SlotBitmap(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+        SlotBitmap(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)) },
+    rating_index_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+    document_id_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+    slot_signatures_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)),
+    signatures_(memory_->GetResource(IndexCategory::DOCUMENT_METADATA)) {
     CheckValidity(stop_words);
-    stop_words_ = MakeUniqueNonEmptyStrings(stop_words);
+    stop_words_ = StopWordFilter::Of(MakeUniqueNonEmptyStrings(stop_words));
 }
 
-template <typename DocumentPredicate>
+template <typename Scoring, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocumentsFiltered<Scoring>(raw_query, MakePredicateFilter(document_predicate));
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status) const {
+    return FindTopDocumentsFiltered<Scoring>(raw_query, MakeStatusFilter(status));
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status,
+    RatingRange ratings) const {
+    if (ratings.min_rating > ratings.max_rating) {
+        throw std::invalid_argument("invalid rating range");
+    }
+    return FindTopDocumentsFiltered<Scoring>(raw_query, [this, status, ratings](SlotBitmap& candidates) {
+        MakeStatusFilter(status)(candidates);
+        FilterByRating(candidates, ratings, &QueryArena::ForThisThread());
+        });
+}
+
+template <typename Scoring, typename CacheLookup>
+std::vector<Document> SearchServer::FindTopDocumentsCached(const std::string& raw_query, DocumentStatus status,
+    CacheLookup cache_lookup) const {
+    return FindTopDocumentsCachedFiltered<Scoring>(raw_query, MakeStatusFilter(status), cache_lookup);
+}
+
+template <typename Scoring, typename DocumentPredicate, typename CacheLookup>
+std::vector<Document> SearchServer::FindTopDocumentsCached(const std::string& raw_query, DocumentPredicate document_predicate,
+    CacheLookup cache_lookup) const {
+    return FindTopDocumentsCachedFiltered<Scoring>(raw_query, MakePredicateFilter(document_predicate), cache_lookup);
+}
 
-    std::vector<Document> result;
-    Query query;
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query) const {
+    return FindTopDocuments<Scoring>(raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Scoring, typename DocumentPredicate>
+SearchResults SearchServer::FindDocuments(const std::string& raw_query, DocumentPredicate document_predicate) const {
+    return FindDocumentsFiltered<Scoring>(raw_query, MakePredicateFilter(document_predicate));
+}
+
+template <typename Scoring>
+SearchResults SearchServer::FindDocuments(const std::string& raw_query, DocumentStatus status) const {
+    return FindDocumentsFiltered<Scoring>(raw_query, MakeStatusFilter(status));
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindDocumentsAfter(const std::string& raw_query, DocumentStatus status,
+    const std::optional<RankingKey>& after, size_t count) const {
+    PROFILE_SCOPE("FindDocumentsAfter");
+
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    Query query(&arena);
     if (!ParseQuery(raw_query, query)) {
         throw std::invalid_argument("invalid request");
     }
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+    if (count == 0) {
+        return {};
+    }
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
-            return lhs.rating > rhs.rating;
+    // the worst of the best count documents on top
+    std::pmr::vector<Document> heap_storage(&arena);
+    heap_storage.reserve(count);
+    std::priority_queue<Document, std::pmr::vector<Document>, decltype(&RanksBefore)> best(RanksBefore, std::move(heap_storage));
+    ForEachMatch<Scoring>(query, MakeStatusFilter(status), &arena, [&](const Document& document) {
+        if (after && !(*after < RankingKey::Of(document))) {
+            return;
         }
-        else {
-            return lhs.relevance > rhs.relevance;
+        if (best.size() < count) {
+            best.push(document);
+        }
+        else if (RanksBefore(document, best.top())) {
+            best.pop();
+            best.push(document);
         }
         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+    std::vector<Document> documents(best.size());
+    for (auto it = documents.rbegin(); it != documents.rend(); ++it) {
+        *it = best.top();
+        best.pop();
     }
+    return documents;
+}
 
-    
-    result.swap(matched_documents);
-    return result;
+template <typename Scoring>
+std::vector<Document> SearchServer::FindDocumentsAfter(const std::string& raw_query, DocumentStatus status,
+    const std::optional<RankingKey>& after) const {
+    std::vector<Document> documents;
+    ForEachDocumentAfter<Scoring>(raw_query, status, after, [&documents](const Document& document) {
+        documents.push_back(document);
+        });
+    return documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+template <typename Scoring, typename DocumentSink>
+void SearchServer::ForEachDocumentAfter(const std::string& raw_query, DocumentStatus status,
+    const std::optional<RankingKey>& after, DocumentSink sink) const {
+    PROFILE_SCOPE("FindDocumentsAfter");
 
-    for (const std::string& word : query.plus_words) {
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
 
-        for (const auto [document_id, word_freq] : doc_to_word_freqs_) {
+    Query query(&arena);
+    if (!ParseQuery(raw_query, query)) {
+        throw std::invalid_argument("invalid request");
+    }
+    ForEachMatch<Scoring>(query, MakeStatusFilter(status), &arena, [&](const Document& document) {
+        if (!after || *after < RankingKey::Of(document)) {
+            sink(document);
+        }
+        });
+}
 
-            const auto& document_data = documents_.at(document_id);
+template <typename Scoring, typename CandidateFilter>
+std::vector<Document> SearchServer::FindTopDocumentsFiltered(const std::string& raw_query, CandidateFilter candidate_filter) const {
+    PROFILE_SCOPE("FindTopDocuments");
 
-            for (const auto [w, fr] : word_freq) {
-                if (w == word) {
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id] += fr * inverse_document_freq;
-                    }
-                    continue;
-                }
-            }
-        }
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    Query query(&arena);
+    if (!ParseQuery(raw_query, query)) {
+        throw std::invalid_argument("invalid request");
     }
+    return FindTopDocuments<Scoring>(query, candidate_filter, arena);
+}
 
+template <typename Scoring, typename CandidateFilter, typename CacheLookup>
+std::vector<Document> SearchServer::FindTopDocumentsCachedFiltered(const std::string& raw_query, CandidateFilter candidate_filter,
+    CacheLookup cache_lookup) const {
+    PROFILE_SCOPE("FindTopDocuments");
 
-    for (const std::string& word : query.minus_words) {
-        for (const auto& [id, doc] : doc_to_word_freqs_) {
-            if (document_to_relevance.count(id)) {
-                for (const auto& [w, fr] : doc) {
-                    if (w == word) {
-                        document_to_relevance.erase(id);
-                        continue;
-                    }
-                }
-            }
-        }
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    Query query(&arena);
+    if (!ParseQuery(raw_query, query)) {
+        throw std::invalid_argument("invalid request");
     }
+    if (const std::vector<Document>* cached = cache_lookup(MakeQueryKey(query))) {
+        return *cached;
+    }
+    return FindTopDocuments<Scoring>(query, candidate_filter, arena);
+}
+
+template <typename Scoring, typename CandidateFilter>
+std::vector<Document> SearchServer::FindTopDocuments(const Query& query, CandidateFilter candidate_filter, QueryArena& arena) const {
+    auto matched_documents = FindAllDocuments<Scoring>(query, candidate_filter, &arena);
+
+    // only the top is ordered
+    const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), RanksBefore);
+    matched_documents.erase(top_end, matched_documents.end());
+
+    // the only allocation outside of the arena
+    return std::vector<Document>(matched_documents.begin(), matched_documents.end());
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template <typename Scoring, typename CandidateFilter>
+SearchResults SearchServer::FindDocumentsFiltered(const std::string& raw_query, CandidateFilter candidate_filter) const {
+    PROFILE_SCOPE("FindDocuments");
+
+    QueryArena& arena = QueryArena::ForThisThread();
+    QueryArena::Scope arena_scope(arena);
+
+    Query query(&arena);
+    if (!ParseQuery(raw_query, query)) {
+        throw std::invalid_argument("invalid request");
     }
+    const auto matched_documents = FindAllDocuments<Scoring>(query, candidate_filter, &arena);
+    return SearchResults(std::vector<Document>(matched_documents.begin(), matched_documents.end()));
+}
+
+template <typename Scoring, typename CandidateFilter>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Query& query, CandidateFilter candidate_filter,
+    std::pmr::memory_resource* resource) const {
+    PROFILE_SCOPE("FindAllDocuments");
+    std::pmr::vector<Document> matched_documents(resource);
+    ForEachMatch<Scoring>(query, candidate_filter, resource, [&matched_documents](const Document& document) {
+        matched_documents.push_back(document);
+        });
     return matched_documents;
 }
 
+template <typename Scoring, typename CandidateFilter, typename DocumentSink>
+void SearchServer::ForEachMatch(const Query& query, CandidateFilter candidate_filter,
+    std::pmr::memory_resource* resource, DocumentSink sink) const {
+    // candidates: slots with a plus word and without minus words
+    SlotBitmap candidates(slots_.size(), resource);
+    std::pmr::vector<const Postings*> plus_postings(resource);
+    // 1 unless the word is a fuzzy variant
+    std::pmr::vector<double> plus_weights(resource);
+    size_t plus_posting_count = 0;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const auto postings = word_to_document_freqs_.find(query.plus_words[i]);
+        if (postings == word_to_document_freqs_.end()) {
+            continue;
+        }
+        plus_postings.push_back(&postings->second);
+        plus_weights.push_back(std::pow(FUZZY_DISCOUNT, query.plus_distances[i]));
+        plus_posting_count += postings->second.size();
+        for (const uint32_t slot : postings->second.slots) {
+            candidates.Set(slot);
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end()) {
+            continue;
+        }
+        for (const uint32_t slot : postings->second.slots) {
+            candidates.Reset(slot);
+        }
+    }
+    candidate_filter(candidates);
+
+    const size_t candidate_count = candidates.Count();
+    const CollectionStatistics collection = GetCollectionStatistics();
+
+    if (candidate_count * DENSE_SCORES_RATIO >= plus_posting_count) {
+        // every posting is added without a branch; the postings tell what to reset afterwards
+        double* const scores = GetDenseScores(slots_.size()).data();
+        for (size_t word = 0; word < plus_postings.size(); ++word) {
+            const Postings* const postings = plus_postings[word];
+            const typename Scoring::TermScorer term_scorer(collection, postings->size());
+            const double weight = plus_weights[word];
+            const uint32_t* const slots = postings->slots.data();
+            const double* const term_freqs = postings->term_freqs.data();
+            for (size_t i = 0; i < postings->size(); ++i) {
+                scores[slots[i]] += weight * term_scorer(term_freqs[i], slots_[slots[i]].length);
+            }
+        }
+        candidates.ForEach([&](size_t slot) {
+            sink(Document{ slots_[slot].document_id, scores[slot], slots_[slot].rating });
+            });
+        for (const Postings* postings : plus_postings) {
+            for (const uint32_t slot : postings->slots) {
+                scores[slot] = 0.0;
+            }
+        }
+    }
+    else {
+        // few candidates left after filtering: collect their contributions and sum them up by slot
+        struct Contribution {
+            uint32_t slot;
+            uint32_t word;
+            double score;
+        };
+        std::pmr::vector<Contribution> contributions(resource);
+        for (uint32_t word = 0; word < plus_postings.size(); ++word) {
+            const Postings& postings = *plus_postings[word];
+            const typename Scoring::TermScorer term_scorer(collection, postings.size());
+            const double weight = plus_weights[word];
+            for (size_t i = 0; i < postings.size(); ++i) {
+                const uint32_t slot = postings.slots[i];
+                if (candidates.Test(slot)) {
+                    contributions.push_back({ slot, word, weight * term_scorer(postings.term_freqs[i], slots_[slot].length) });
+                }
+            }
+        }
+        // the contributions of a slot are summed in the order of the words, as in the dense array
+        std::sort(contributions.begin(), contributions.end(), [](const Contribution& lhs, const Contribution& rhs) {
+            return lhs.slot != rhs.slot ? lhs.slot < rhs.slot : lhs.word < rhs.word;
+            });
+        for (size_t i = 0; i < contributions.size();) {
+            const uint32_t slot = contributions[i].slot;
+            double relevance = 0.0;
+            for (; i < contributions.size() && contributions[i].slot == slot; ++i) {
+                relevance += contributions[i].score;
+            }
+            sink(Document{ slots_[slot].document_id, relevance, slots_[slot].rating });
+        }
+    }
+}
+
 template <typename StringContainer>
 void SearchServer::CheckValidity(const StringContainer& strings) {
     for (const std::string& str : strings) {
@@ -194,11 +770,13 @@ void SearchServer::CheckValidity(const StringContainer& strings) {
 }
 
 template <typename StringContainer>
-std::set<std::string> SearchServer::MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> SearchServer::MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (const std::string& str : strings) {
         if (!str.empty()) {
-            non_empty_strings.insert(str);
+            std::string word = str;
+            tokenizer_.FoldCase(word);
+            non_empty_strings.insert(std::move(word));
         }
     }
     return non_empty_strings;
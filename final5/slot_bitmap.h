@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Set of internal document slots, a bit per slot.
+// Bits past the end are clear; Set grows the bitmap as needed.
+class SlotBitmap {
+    inline static constexpr size_t WORD_BITS = 64;
+
+    std::pmr::vector<uint64_t> words_;
+
+public:
+    explicit SlotBitmap(std::pmr::memory_resource* resource) : words_(resource) {}
+
+    // size bits, all clear
+    SlotBitmap(size_t size, std::pmr::memory_resource* resource) : words_((size + WORD_BITS - 1) / WORD_BITS, 0, resource) {}
+
+    inline size_t GetSize() const noexcept {
+        return words_.size() * WORD_BITS;
+    }
+
+    inline void Set(size_t slot) {
+        const size_t word = slot / WORD_BITS;
+        if (word >= words_.size()) {
+            words_.resize(word + 1, 0);
+        }
+        words_[word] |= uint64_t{ 1 } << (slot % WORD_BITS);
+    }
+
+    inline void Reset(size_t slot) noexcept {
+        const size_t word = slot / WORD_BITS;
+        if (word < words_.size()) {
+            words_[word] &= ~(uint64_t{ 1 } << (slot % WORD_BITS));
+        }
+    }
+
+    inline bool Test(size_t slot) const noexcept {
+        const size_t word = slot / WORD_BITS;
+        return word < words_.size() && (words_[word] >> (slot % WORD_BITS) & 1) != 0;
+    }
+
+    // Keeps the bits set in both, a word at a time
+    inline void And(const SlotBitmap& other) noexcept {
+        const size_t common = std::min(words_.size(), other.words_.size());
+        for (size_t i = 0; i < common; ++i) {
+            words_[i] &= other.words_[i];
+        }
+        for (size_t i = common; i < words_.size(); ++i) {
+            words_[i] = 0;
+        }
+    }
+
+    inline size_t Count() const noexcept {
+        size_t count = 0;
+        for (const uint64_t word : words_) {
+            count += __builtin_popcountll(word);
+        }
+        return count;
+    }
+
+    // Calls f(slot) for the set bits in ascending order; f may reset the bit it is given
+    template <typename F>
+    void ForEach(F f) const {
+        for (size_t i = 0; i < words_.size(); ++i) {
+            for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+                f(i * WORD_BITS + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    // Gives the memory back to the resource
+    inline void Clear() noexcept {
+        std::pmr::vector<uint64_t>(words_.get_allocator()).swap(words_);
+    }
+};
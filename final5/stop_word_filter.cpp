@@ -0,0 +1,127 @@
+#include "stop_word_filter.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+// words per bucket on average; larger buckets are placed first, while most slots are free
+constexpr size_t BUCKET_LOAD = 2;
+// seeds tried for the whole table before giving up
+constexpr uint64_t MAX_SEEDS = 64;
+
+} // namespace
+
+StopWordFilter::StopWordFilter(const std::vector<std::string_view>& words) {
+    std::vector<std::string_view> unique_words = words;
+    std::sort(unique_words.begin(), unique_words.end());
+    unique_words.erase(std::unique(unique_words.begin(), unique_words.end()), unique_words.end());
+    if (unique_words.empty()) {
+        return;
+    }
+
+    for (seed_ = 0; seed_ < MAX_SEEDS; ++seed_) {
+        if (TryBuild(unique_words)) {
+            return;
+        }
+    }
+    // only if two words have equal 64-bit hashes under every seed
+    throw std::runtime_error("cannot build a perfect hash of the stop words"s);
+}
+
+bool StopWordFilter::Contains(std::string_view word) const noexcept {
+    if ((length_mask_ & LengthBit(word.size())) == 0) {
+        return false;
+    }
+    const uint64_t hash = Hash(word, seed_);
+    const uint32_t displacement = displacements_[hash % displacements_.size()];
+    return WordAt(entries_[Mix(hash, displacement) % entries_.size()]) == word;
+}
+
+uint64_t StopWordFilter::Hash(std::string_view word, uint64_t seed) noexcept {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+uint64_t StopWordFilter::Mix(uint64_t hash, uint32_t displacement) noexcept {
+    // the finalizer of SplitMix64
+    hash += (displacement + 1) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+uint64_t StopWordFilter::LengthBit(size_t length) noexcept {
+    return uint64_t{ 1 } << std::min<size_t>(length, 63);
+}
+
+// Hash and displace: the words are grouped into buckets, then every bucket,
+// the largest first, gets the first displacement sending all its words to free slots
+[[nodiscard]] bool StopWordFilter::TryBuild(const std::vector<std::string_view>& words) {
+    const size_t word_count = words.size();
+    const size_t bucket_count = (word_count + BUCKET_LOAD - 1) / BUCKET_LOAD;
+
+    std::vector<uint64_t> hashes(word_count);
+    std::vector<std::vector<size_t>> buckets(bucket_count);
+    for (size_t i = 0; i < word_count; ++i) {
+        hashes[i] = Hash(words[i], seed_);
+        buckets[hashes[i] % bucket_count].push_back(i);
+    }
+    std::vector<size_t> order(bucket_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+        });
+
+    // a bucket needs about word_count / free_slots tries; the bound leaves a wide margin
+    const uint64_t max_displacement = 64 * static_cast<uint64_t>(word_count) + 1024;
+    std::vector<size_t> slot_to_word(word_count, word_count);
+    std::vector<uint32_t> displacements(bucket_count, 0);
+    std::vector<size_t> slots;
+    for (const size_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint64_t displacement = 0; displacement < max_displacement && !placed; ++displacement) {
+            slots.clear();
+            placed = true;
+            for (const size_t word : buckets[bucket]) {
+                const size_t slot = Mix(hashes[word], static_cast<uint32_t>(displacement)) % word_count;
+                if (slot_to_word[slot] != word_count || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed) {
+                displacements[bucket] = static_cast<uint32_t>(displacement);
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    slot_to_word[slots[i]] = buckets[bucket][i];
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+
+    text_.clear();
+    entries_.assign(word_count, Entry{});
+    length_mask_ = 0;
+    for (size_t slot = 0; slot < word_count; ++slot) {
+        const std::string_view word = words[slot_to_word[slot]];
+        entries_[slot] = { static_cast<uint32_t>(text_.size()), static_cast<uint32_t>(word.size()) };
+        text_ += word;
+        length_mask_ |= LengthBit(word.size());
+    }
+    displacements_ = std::move(displacements);
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of words with a minimal perfect hash: a lookup hashes the word once,
+// reads one displacement and compares with at most one stored word.
+// Words of a length no stop word has are rejected before hashing.
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+
+    // Duplicates are kept once
+    explicit StopWordFilter(const std::vector<std::string_view>& words);
+
+    template <typename StringContainer>
+    static StopWordFilter Of(const StringContainer& words) {
+        return StopWordFilter(std::vector<std::string_view>(std::begin(words), std::end(words)));
+    }
+
+    bool Contains(std::string_view word) const noexcept;
+
+    inline size_t GetSize() const noexcept {
+        return entries_.size();
+    }
+
+    inline bool IsEmpty() const noexcept {
+        return entries_.empty();
+    }
+
+    // Bytes of the tables, by capacity
+    inline size_t GetMemoryUsage() const noexcept {
+        return text_.capacity() + entries_.capacity() * sizeof(Entry) + displacements_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct Entry {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    // the words one after another
+    std::string text_;
+    // one per slot of the hash table, as many as words
+    std::vector<Entry> entries_;
+    // per bucket, the seed placing its words into free slots
+    std::vector<uint32_t> displacements_;
+    uint64_t seed_ = 0;
+    // bit n is set if a word of length n is present, bit 63 stands for every longer one
+    uint64_t length_mask_ = 0;
+
+    static uint64_t Hash(std::string_view word, uint64_t seed) noexcept;
+
+    static uint64_t Mix(uint64_t hash, uint32_t displacement) noexcept;
+
+    static uint64_t LengthBit(size_t length) noexcept;
+
+    [[nodiscard]] bool TryBuild(const std::vector<std::string_view>& words);
+
+    std::string_view WordAt(const Entry& entry) const noexcept {
+        return { text_.data() + entry.offset, entry.length };
+    }
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+// C++20 coroutines: requires -std=c++20
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Lazily started coroutine producing a T. It starts when awaited and resumes
+// the awaiting coroutine on the thread it completes on.
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+                return handle.promise().continuation;
+            }
+            void await_resume() const noexcept {}
+        };
+
+        FinalAwaiter final_suspend() const noexcept {
+            return {};
+        }
+
+        template <typename U>
+        void return_value(U&& result) {
+            value.emplace(std::forward<U>(result));
+        }
+
+        void unhandled_exception() noexcept {
+            exception = std::current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    ~Task() {
+        Destroy();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+            T await_resume() const {
+                promise_type& promise = handle.promise();
+                if (promise.exception) {
+                    std::rethrow_exception(promise.exception);
+                }
+                return std::move(*promise.value);
+            }
+        };
+        return Awaiter{ handle_ };
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    void Destroy() noexcept {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+};
+
+namespace detail {
+
+// Eagerly started coroutine which frees itself on completion
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() const noexcept {
+            return {};
+        }
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+    };
+};
+
+template <typename T>
+struct SyncWaitState {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    std::optional<T> value;
+    std::exception_ptr exception;
+};
+
+template <typename T>
+DetachedTask RunAndNotify(Task<T> task, SyncWaitState<T>& state) {
+    std::optional<T> value;
+    std::exception_ptr exception;
+    try {
+        value.emplace(co_await std::move(task));
+    }
+    catch (...) {
+        exception = std::current_exception();
+    }
+    // notify under the lock: the waiter destroys the state as soon as it sees done
+    std::lock_guard lock(state.mutex);
+    state.value = std::move(value);
+    state.exception = exception;
+    state.done = true;
+    state.done_cv.notify_one();
+}
+
+template <typename T>
+struct WhenAllState {
+    std::atomic<size_t> pending;
+    std::coroutine_handle<> continuation;
+    std::vector<std::optional<T>> values;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    explicit WhenAllState(size_t count) : pending(count + 1), values(count) {}
+
+    // true for the last one to arrive
+    bool Arrive() noexcept {
+        return pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+};
+
+template <typename T>
+DetachedTask RunWhenAllChild(Task<T> task, WhenAllState<T>& state, size_t index) {
+    try {
+        state.values[index].emplace(co_await std::move(task));
+    }
+    catch (...) {
+        std::lock_guard lock(state.exception_mutex);
+        if (!state.exception) {
+            state.exception = std::current_exception();
+        }
+    }
+    if (state.Arrive()) {
+        state.continuation.resume();
+    }
+}
+
+} // namespace detail
+
+// Blocks the calling thread until the task completes
+template <typename T>
+T SyncWait(Task<T> task) {
+    detail::SyncWaitState<T> state;
+    detail::RunAndNotify(std::move(task), state);
+
+    std::unique_lock lock(state.mutex);
+    state.done_cv.wait(lock, [&state] { return state.done; });
+    if (state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+    return std::move(*state.value);
+}
+
+// Runs the tasks concurrently, results keep the order of tasks.
+// If some tasks fail, the first exception is rethrown after all of them complete
+template <typename T>
+Task<std::vector<T>> WhenAll(std::vector<Task<T>> tasks) {
+    detail::WhenAllState<T> state(tasks.size());
+
+    struct Awaiter {
+        std::vector<Task<T>>& tasks;
+        detail::WhenAllState<T>& state;
+
+        bool await_ready() const noexcept {
+            return tasks.empty();
+        }
+        bool await_suspend(std::coroutine_handle<> continuation) {
+            state.continuation = continuation;
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                detail::RunWhenAllChild(std::move(tasks[i]), state, i);
+            }
+            // suspend unless every child has already completed inline
+            return !state.Arrive();
+        }
+        void await_resume() const noexcept {}
+    };
+    co_await Awaiter{ tasks, state };
+
+    if (state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+    std::vector<T> results;
+    results.reserve(state.values.size());
+    for (std::optional<T>& value : state.values) {
+        results.push_back(std::move(*value));
+    }
+    co_return results;
+}
@@ -1,4 +1,21 @@
-/*#include "test_example_functions.h"
+#include "test_example_functions.h"
+
+#include "async_request_queue.h"
+#include "async_search.h"
+#include "external_index.h"
+#include "paginator.h"
+#include "profiler.h"
+#include "request_queue.h"
+#include "search_cursor.h"
+
+#include <cstring>
+#include <forward_list>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 template <typename Func>
 void RunTestImpl(Func f, const std::string& s) {
@@ -26,7 +43,14 @@ void AssertImpl(bool expression,
 template <typename T, typename U>
 void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
     const std::string& func, unsigned line, const std::string& hint) {
-    if (t != u) {
+    bool equal;
+    if constexpr (std::is_integral_v<T> && std::is_integral_v<U> && std::is_signed_v<T> != std::is_signed_v<U>) {
+        // size() against an int literal, compared by value
+        equal = std::cmp_equal(t, u);
+    } else {
+        equal = t == u;
+    }
+    if (!equal) {
         std::cerr << std::boolalpha;
         std::cerr << file << "(" << line << "): " << func << ": ";
         std::cerr << "ASSERT_EQUAL(" << t_str << ", " << u_str << ") failed: ";
@@ -209,7 +233,7 @@ void TestSortingByPredicate() {
 
     //search for documents with the condition: rating no more than 8 and no less than 2
     const std::vector<Document>& fdsp = server.FindTopDocuments("-1word2 -2word1 3word1 3word2 3word3 4word1 5word5 5word2 6word3 6word1",
-        [](const int id, const DocumentStatus ds, int rating) {return rating < 8 && 2 < rating; });
+        [](int, DocumentStatus, int rating) {return rating < 8 && 2 < rating; });
 
     ASSERT_EQUAL_HINT(fdsp.size(), 2, "docs with rating 4");
 }
@@ -262,9 +286,9 @@ void TestIterators() {
 
 void TestGetWordFrequencies() {
     SearchServer server = GetTestServer();
-    const std::map<std::string, double>& result1 = server.GetWordFrequencies(1);
-    const std::map<std::string, double>& result5 = server.GetWordFrequencies(5);
-    const std::map<std::string, double>& result8 = server.GetWordFrequencies(8);
+    const SearchServer::WordFrequencies& result1 = server.GetWordFrequencies(1);
+    const SearchServer::WordFrequencies& result5 = server.GetWordFrequencies(5);
+    const SearchServer::WordFrequencies& result8 = server.GetWordFrequencies(8);
 
     ASSERT_EQUAL(result1.size(), 3);
 
@@ -274,6 +298,11 @@ void TestGetWordFrequencies() {
     ASSERT_EQUAL(is_equal(result5.at("6word2"), 0.6), false);
 
     ASSERT_EQUAL(result8.size(), 0);
+
+    // unknown and removed ids share one empty map, which used to be allocated on every call and leaked
+    ASSERT(&server.GetWordFrequencies(9) == &result8);
+    server.RemoveDocument(5);
+    ASSERT(&server.GetWordFrequencies(5) == &result8);
 }
 
 void TestRemoveDocuments() {
@@ -293,7 +322,7 @@ void TestRemoveDocuments() {
 void TestRemoveDuplicates() {
     SearchServer server = GetTestServerWithDuplicates();
     RemoveDuplicates(server);
-    const std::map<std::string, double> empty;
+    const SearchServer::WordFrequencies empty;
 
     ASSERT(server.GetWordFrequencies(1) != empty);
     ASSERT(server.GetWordFrequencies(2) != empty);
@@ -304,6 +333,1402 @@ void TestRemoveDuplicates() {
     ASSERT(server.GetWordFrequencies(7) == empty);
 }
 
+void TestRequestQueueNoResultRequests() {
+    SearchServer server = GetTestServer();
+    RequestQueue queue(server, 0, RequestQueue::MINUTES_IN_DAY, 3);
+
+    queue.AddFindRequest("1word2");
+    queue.AddFindRequest("nothing");
+    queue.AddFindRequest("nothing");
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 2);
+
+    // capacity is 3: the first request is evicted
+    queue.AddFindRequest("nothing");
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 3);
+    ASSERT_EQUAL(queue.GetRequestCount(), 3);
+
+    ASSERT_EQUAL(queue.GetStatistics().GetRequestCount(), 4u);
+    ASSERT_EQUAL(queue.GetStatistics().GetResultCountFrequency(0), 3u);
+    // the evicted request was within the day
+    ASSERT_EQUAL(queue.GetEvictedRequests(), 1u);
+
+    try {
+        RequestQueue empty(server, 0, RequestQueue::MINUTES_IN_DAY, 0);
+        ASSERT_HINT(false, "a queue without capacity must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // requests expire with the window, whatever the capacity
+    static RequestQueue::Clock::time_point now;
+    now = RequestQueue::Clock::time_point() + std::chrono::hours(24);
+    RequestQueue windowed(server, 0, std::chrono::minutes(1), 100, [] { return now; });
+    windowed.AddFindRequest("nothing");
+    now += std::chrono::seconds(30);
+    windowed.AddFindRequest("nothing");
+    windowed.AddFindRequest("1word2");
+    ASSERT_EQUAL(windowed.GetNoResultRequests(), 2);
+    ASSERT_EQUAL(windowed.GetRequestCount(), 3);
+
+    // the first one is a minute old
+    now += std::chrono::seconds(30);
+    windowed.AddFindRequest("1word2");
+    ASSERT_EQUAL(windowed.GetNoResultRequests(), 1);
+    ASSERT_EQUAL(windowed.GetRequestCount(), 3);
+
+    now += std::chrono::minutes(5);
+    windowed.AddFindRequest("1word2");
+    ASSERT_EQUAL(windowed.GetNoResultRequests(), 0);
+    ASSERT_EQUAL(windowed.GetRequestCount(), 1);
+    ASSERT_EQUAL(windowed.GetEvictedRequests(), 0u);
+}
+
+void TestRequestQueueCache() {
+    SearchServer server = GetTestServer();
+    RequestQueue queue(server);
+
+    const std::vector<Document> first = queue.AddFindRequest("1word2 1word3");
+    // same words in another order plus a stop word
+    const std::vector<Document> second = queue.AddFindRequest("1word3 1word1 1word2");
+    ASSERT_EQUAL(first.size(), second.size());
+    ASSERT_EQUAL(queue.GetCacheStatistics().hits, 1u);
+    ASSERT_EQUAL(queue.GetCacheStatistics().misses, 1u);
+
+    // the same text is found by the raw query, before parsing; a miss of it alone is not counted
+    ASSERT_EQUAL(queue.AddFindRequest("1word2 1word3").size(), first.size());
+    ASSERT_EQUAL(queue.AddFindRequest("1word3 1word1 1word2").size(), first.size());
+    ASSERT_EQUAL(queue.GetCacheStatistics().hits, 3u);
+    ASSERT_EQUAL(queue.GetCacheStatistics().misses, 1u);
+
+    // another status is another key
+    queue.AddFindRequest("1word2 1word3", DocumentStatus::BANNED);
+    ASSERT_EQUAL(queue.GetCacheStatistics().misses, 2u);
+
+    // so is another predicate key, for the raw query too
+    const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    const std::vector<Document> even_first = queue.AddFindRequest("1word2 1word3", "even", even);
+    ASSERT_EQUAL(queue.AddFindRequest("1word2 1word3", "even", even).size(), even_first.size());
+    ASSERT_EQUAL(queue.GetCacheStatistics().misses, 3u);
+    ASSERT_EQUAL(queue.GetCacheStatistics().hits, 4u);
+
+    // a raw query means something else under another syntax
+    server.SetQuerySyntax({ .patterns = true });
+    queue.AddFindRequest("1word2 1word3");
+    ASSERT_EQUAL(queue.GetCacheStatistics().misses, 4u);
+    ASSERT_EQUAL(queue.GetCacheStatistics().invalidations, 1u);
+    server.SetQuerySyntax({});
+
+    // changes of the index invalidate the cache
+    server.AddDocument(100, "1word2", DocumentStatus::ACTUAL, { 1 });
+    const std::vector<Document> third = queue.AddFindRequest("1word2 1word3");
+    ASSERT_EQUAL(third.size(), first.size() + 1);
+    ASSERT_EQUAL(queue.GetCacheStatistics().invalidations, 2u);
+}
+
+void TestAsyncRequests() {
+    SearchServer server = GetTestServer();
+    const std::vector<Document> expected = server.FindTopDocuments("1word2 5word3 6word1");
+
+    AsyncRequestQueue queue(server, 2, 4);
+    std::vector<std::future<std::vector<Document>>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(queue.AddFindRequest("1word2 5word3 6word1"));
+    }
+    for (std::future<std::vector<Document>>& future : futures) {
+        ASSERT_EQUAL(future.get().size(), expected.size());
+    }
+
+    ThreadPool pool(2, 4);
+    const std::vector<Document> result = SyncWait(FindTopDocumentsAsync(pool, server, "1word2 5word3 6word1"s));
+    ASSERT_EQUAL(result.size(), expected.size());
+    ASSERT_EQUAL(result[0].id, expected[0].id);
+
+    bool thrown = false;
+    try {
+        SyncWait(FindTopDocumentsAsync(pool, server, "--1word2"s));
+    }
+    catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestQueryArena() {
+    SearchServer server = GetTestServer();
+    const std::string query = "-1word2 -2word1 3word1 3word2 3word3 4word1 5word5 5word2 6word3 6word1";
+
+    const std::vector<Document> expected = server.FindTopDocuments(query);
+    const uint64_t allocations = QueryArena::ForThisThread().GetUpstreamAllocations();
+
+    // the arena has grown during the first query and is reused since
+    for (int i = 0; i < 10; ++i) {
+        const std::vector<Document> result = server.FindTopDocuments(query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        ASSERT_EQUAL(result[0].id, expected[0].id);
+        server.MatchDocument(query, 4);
+    }
+    ASSERT_EQUAL(QueryArena::ForThisThread().GetUpstreamAllocations(), allocations);
+
+    // several chunks are merged into one when the scope ends
+    QueryArena& arena = QueryArena::ForThisThread();
+    {
+        QueryArena::Scope scope(arena);
+        std::pmr::vector<char> large(QueryArena::INITIAL_CHUNK_SIZE * 4, 'a', &arena);
+    }
+    const size_t capacity = arena.GetCapacity();
+    {
+        QueryArena::Scope scope(arena);
+        std::pmr::vector<char> large(QueryArena::INITIAL_CHUNK_SIZE * 4, 'a', &arena);
+    }
+    ASSERT_EQUAL(arena.GetCapacity(), capacity);
+}
+
+void TestIndexPoolAllocation() {
+    SearchServer heap_server("and in"s);
+    SearchServer pool_server("and in"s, IndexAllocation::POOL);
+    for (SearchServer* server : { &heap_server, &pool_server }) {
+        for (int id = 0; id < 100; ++id) {
+            server->AddDocument(id, "cat dog and bird in hat " + std::to_string(id) + "word",
+                DocumentStatus::ACTUAL, { id });
+        }
+    }
+    const std::vector<Document> expected = heap_server.FindTopDocuments("dog 7word");
+    const std::vector<Document> result = pool_server.FindTopDocuments("dog 7word");
+    ASSERT_EQUAL(result.size(), expected.size());
+    ASSERT_EQUAL(result[0].id, expected[0].id);
+    ASSERT(pool_server.GetIndexMemory().GetAllocation() == IndexAllocation::POOL);
+
+    // the pool takes whole chunks from the heap
+    const TrackingResource& pool_heap = pool_server.GetIndexMemory().GetHeap();
+    ASSERT(pool_heap.GetAllocations() * 10 < heap_server.GetIndexMemory().GetHeap().GetAllocations());
+
+    // moving keeps the index in its memory
+    SearchServer moved = std::move(pool_server);
+    ASSERT_EQUAL(moved.FindTopDocuments("dog 7word")[0].id, expected[0].id);
+
+    // removal of the last document returns every chunk at once
+    for (int id = 0; id < 100; ++id) {
+        moved.RemoveDocument(id);
+        heap_server.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(moved.GetIndexMemory().GetHeap().GetBytesInUse(), 0u);
+    ASSERT_EQUAL(heap_server.GetIndexMemory().GetHeap().GetBytesInUse(), 0u);
+
+    moved.AddDocument(1, "cat", DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(moved.FindTopDocuments("cat").size(), 1u);
+
+    // so does Clear, without removing them one by one
+    moved.SetDeduplication(Deduplication::REJECT);
+    for (int id = 2; id < 100; ++id) {
+        moved.AddDocument(id, "cat dog " + std::to_string(id) + "word", DocumentStatus::ACTUAL, { id });
+    }
+    const uint64_t generation = moved.GetGeneration();
+    moved.Clear();
+    ASSERT_EQUAL(moved.GetDocumentCount(), 0);
+    ASSERT(moved.GetGeneration() > generation);
+    ASSERT_EQUAL(moved.GetIndexMemory().GetHeap().GetBytesInUse(), 0u);
+    ASSERT(moved.FindTopDocuments("cat").empty());
+    ASSERT(moved.begin() == moved.end());
+
+    ASSERT(moved.AddDocument(2, "cat dog 2word", DocumentStatus::ACTUAL, { 2 }));
+    ASSERT_EQUAL(moved.FindTopDocuments("cat").size(), 1u);
+    ASSERT_EQUAL(moved.GetCollectionStatistics().average_length, 3.0);
+}
+
+void TestIndexChurn() {
+    const std::vector<std::string> vocabulary = { "cat"s, "dog"s, "bird"s, "fish"s, "tail"s, "collar"s, "eyes"s,
+        "park"s, "white"s, "black"s, "fluffy"s, "groomed"s, "starling"s, "evgeny"s, "hat"s, "rat"s };
+    std::mt19937 generator(17);
+    std::map<int, std::string> texts;
+    const auto text_of = [&](int id) -> const std::string& {
+        std::string& text = texts[id];
+        if (id % 10 == 9) {
+            // the words of the previous document, so that some duplicates come and go
+            text = texts[id - 1];
+        }
+        else {
+            for (size_t i = 0; i < 2 + generator() % 5; ++i) {
+                text += vocabulary[generator() % vocabulary.size()] + " "s;
+            }
+        }
+        return text;
+        };
+    const auto add = [](SearchServer& server, int id, const std::string& text) {
+        server.AddDocument(id, text, id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 11 });
+        };
+
+    for (const IndexAllocation allocation : { IndexAllocation::HEAP, IndexAllocation::POOL }) {
+        for (const ForwardIndex forward_index : { ForwardIndex::FULL, ForwardIndex::NONE }) {
+            SearchServer server("and"s, allocation, forward_index);
+            server.SetDeduplication(Deduplication::RECORD);
+            texts.clear();
+            constexpr int LIVE = 200;
+            constexpr int ROUND = 50;
+            for (int id = 0; id < LIVE; ++id) {
+                add(server, id, text_of(id));
+            }
+            // the oldest documents give way to new ones, the server never empties
+            size_t warm_heap = 0;
+            for (int round = 0; round < 40; ++round) {
+                for (int id = round * ROUND; id < (round + 1) * ROUND; ++id) {
+                    server.RemoveDocument(id);
+                    texts.erase(id);
+                }
+                for (int id = LIVE + round * ROUND; id < LIVE + (round + 1) * ROUND; ++id) {
+                    add(server, id, text_of(id));
+                }
+                const size_t heap = server.MemoryStats().heap;
+                if (round == 3) {
+                    warm_heap = heap;
+                }
+                else if (round > 3) {
+                    ASSERT_HINT(heap <= warm_heap + warm_heap / 4, "the index must stay bounded under churn"s);
+                }
+            }
+            ASSERT_EQUAL(server.GetDocumentCount(), LIVE);
+
+            // the compacted server answers as one built from the live documents
+            SearchServer fresh("and"s, allocation, forward_index);
+            fresh.SetDeduplication(Deduplication::RECORD);
+            for (const auto& [id, text] : texts) {
+                add(fresh, id, text);
+            }
+            for (const std::string& query : { "cat"s, "fluffy cat -collar"s, "bird fish park white black"s, "rat -hat"s }) {
+                ASSERT(IsSameRanking(server.FindTopDocuments(query), fresh.FindTopDocuments(query)));
+                ASSERT(IsSameRanking(server.FindTopDocuments(query, DocumentStatus::BANNED),
+                    fresh.FindTopDocuments(query, DocumentStatus::BANNED)));
+                ASSERT(IsSameRanking(server.FindTopDocuments(query, DocumentStatus::ACTUAL, { 3, 6 }),
+                    fresh.FindTopDocuments(query, DocumentStatus::ACTUAL, { 3, 6 })));
+            }
+            for (const auto& [id, text] : texts) {
+                ASSERT(server.MatchDocument(text, id) == fresh.MatchDocument(text, id));
+            }
+            ASSERT(server.GetDuplicates() == fresh.GetDuplicates());
+            ASSERT(!server.GetDuplicates().empty());
+        }
+    }
+}
+
+void TestBm25Ranking() {
+    SearchServer server("and"s);
+    server.AddDocument(0, "cat and dog", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(1, "cat dog bird fish", DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(2, "bird", DocumentStatus::ACTUAL, { 3 });
+    ASSERT(is_equal(server.GetCollectionStatistics().average_length, 7.0 / 3));
+
+    const std::vector<Document> tf_idf = server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(tf_idf.size(), 2u);
+    ASSERT(is_equal(tf_idf[0].relevance, 0.5 * std::log(1.5)));
+
+    // the shorter document wins, the same count of the term
+    const std::vector<Document> bm25 = server.FindTopDocuments<Bm25>("cat"s);
+    ASSERT_EQUAL(bm25.size(), 2u);
+    ASSERT_EQUAL(bm25[0].id, 0);
+    ASSERT(is_equal(bm25[0].relevance, 2.2 * std::log(1.6) / (1.0 + 1.2 * (0.25 + 0.75 * 2 / (7.0 / 3)))));
+    ASSERT(is_equal(bm25[1].relevance, 2.2 * std::log(1.6) / (1.0 + 1.2 * (0.25 + 0.75 * 4 / (7.0 / 3)))));
+
+    ASSERT_EQUAL(server.FindTopDocuments<Bm25>("bird -fish"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments<Bm25>("cat"s, DocumentStatus::BANNED).size(), 0u);
+
+    server.RemoveDocument(1);
+    ASSERT(is_equal(server.GetCollectionStatistics().average_length, 1.5));
+    ASSERT_EQUAL(server.FindTopDocuments<Bm25>("fish"s).size(), 0u);
+}
+
+void TestStatusAndRatingFilters() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 200; ++id) {
+        const DocumentStatus status = id % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        server.AddDocument(id, id < 100 ? "cat and dog" : "cat bird", status, { id });
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s, DocumentStatus::BANNED).size(), 5u);
+    ASSERT_EQUAL(server.FindTopDocuments("dog -cat"s, DocumentStatus::ACTUAL).size(), 0u);
+
+    // narrow range: built from the rating index
+    const std::vector<Document> narrow = server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, { 10, 13 });
+    ASSERT_EQUAL(narrow.size(), 2u);
+    ASSERT_EQUAL(narrow[0].id, 12);
+    ASSERT_EQUAL(narrow[1].id, 10);
+
+    // wide range, few candidates: ratings checked one by one
+    const std::vector<Document> wide = server.FindTopDocuments("bird"s, DocumentStatus::BANNED, { 0, 150 });
+    ASSERT_EQUAL(wide.size(), 5u);
+    ASSERT_EQUAL(wide[0].id, 149);
+    for (const Document& document : wide) {
+        ASSERT(document.id % 2 == 1 && document.rating <= 150);
+    }
+
+    // removed documents leave their slots and every filter
+    server.RemoveDocument(12);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, { 10, 13 }).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, [](int id, DocumentStatus, int) { return id == 12; }).size(), 0u);
+    server.AddDocument(12, "cat", DocumentStatus::ACTUAL, { 12 });
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, { 10, 13 }).size(), 2u);
+    ASSERT(std::get<1>(server.MatchDocument("cat"s, 12)) == DocumentStatus::ACTUAL);
+
+    // a single rating is a range, an inverted one is rejected
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, { 12, 12 }).size(), 1u);
+    try {
+        server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, { 13, 10 });
+        ASSERT_HINT(false, "an inverted rating range must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestDenseAndSparseScores() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 200; ++id) {
+        server.AddDocument(id, "cat dog " + std::to_string(id % 7) + "word", DocumentStatus::ACTUAL, { id });
+    }
+    const std::string query = "cat dog 3word -5word"s;
+
+    // every document is a candidate: dense scores
+    const std::vector<Document> dense = server.FindTopDocuments(query);
+    ASSERT_EQUAL(dense.size(), 5u);
+    ASSERT_EQUAL(dense[0].id % 7, 3);
+
+    // a single candidate: sparse scores, the same relevance
+    for (const Document& expected : dense) {
+        const std::vector<Document> sparse = server.FindTopDocuments(query, [&expected](int id, DocumentStatus, int) {
+            return id == expected.id;
+            });
+        ASSERT_EQUAL(sparse.size(), 1u);
+        ASSERT_EQUAL(sparse[0].relevance, expected.relevance);
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("5word"s, [](int id, DocumentStatus, int) { return id == 12; }).size(), 1u);
+
+    // the dense array is clean after every query
+    const std::vector<Document> again = server.FindTopDocuments(query);
+    ASSERT_EQUAL(again[0].relevance, dense[0].relevance);
+
+    // removals keep the postings sorted
+    server.RemoveDocument(3);
+    server.RemoveDocument(10);
+    ASSERT_EQUAL(server.FindTopDocuments("3word"s, DocumentStatus::ACTUAL, { 0, 20 }).size(), 1u);
+}
+
+bool IsSameRanking(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+        return RankingKey::Of(l) == RankingKey::Of(r) && l.relevance == r.relevance;
+        });
+}
+
+void TestDeterministicRanking() {
+    // relevances 0.6e-6 apart were "equal" pairwise under the epsilon comparison, not transitively
+    const Document a(1, 0.0, 1);
+    const Document b(2, 0.6e-6, 2);
+    const Document c(3, 1.2e-6, 3);
+    ASSERT(RanksBefore(c, a) && !RanksBefore(a, c));
+    ASSERT(RanksBefore(b, a) == !RanksBefore(a, b));
+    ASSERT(RanksBefore(Document(4, 0.5, 7), Document(9, 0.5, 7)));
+    ASSERT(RanksBefore(Document(9, 0.5, 8), Document(4, 0.5, 7)));
+
+    // ties on relevance and rating, added in shuffled id order
+    SearchServer server("and"s);
+    for (const int id : { 7, 3, 9, 1, 5, 8, 2, 6, 4, 0 }) {
+        server.AddDocument(id, id % 2 == 0 ? "cat dog" : "cat and bird", DocumentStatus::ACTUAL, { id % 3 });
+    }
+    const std::vector<std::string> queries = { "cat", "dog", "cat bird", "cat -dog" };
+    std::vector<std::vector<Document>> expected;
+    for (const std::string& query : queries) {
+        expected.push_back(server.FindTopDocuments(query));
+    }
+    ASSERT_EQUAL(expected[0].size(), 5u);
+    ASSERT_EQUAL(expected[0][0].id, 2);
+    ASSERT_EQUAL(expected[0][1].id, 5);
+
+    RequestQueue request_queue(server);
+    AsyncRequestQueue async_queue(server, 4, 16);
+    ThreadPool pool(4, 16);
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::future<std::vector<Document>>> futures;
+        std::vector<Task<std::vector<Document>>> tasks;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT(IsSameRanking(server.FindTopDocuments(queries[i]), expected[i]));
+            // the second round is served from the cache
+            ASSERT(IsSameRanking(request_queue.AddFindRequest(queries[i]), expected[i]));
+            futures.push_back(async_queue.AddFindRequest(queries[i]));
+            tasks.push_back(FindTopDocumentsAsync(pool, server, queries[i]));
+        }
+        const std::vector<std::vector<Document>> task_results = SyncWait(WhenAll(std::move(tasks)));
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT(IsSameRanking(futures[i].get(), expected[i]));
+            ASSERT(IsSameRanking(task_results[i], expected[i]));
+        }
+    }
+}
+
+void TestLazyPaginator() {
+    const std::forward_list<int> numbers = { 1, 2, 3, 4, 5, 6, 7 };
+    const auto pages = Paginate(numbers, 3);
+    std::vector<int> page_sizes;
+    for (const auto page : pages) {
+        page_sizes.push_back(static_cast<int>(std::distance(page.begin(), page.end())));
+    }
+    ASSERT(page_sizes == std::vector<int>({ 3, 3, 1 }));
+    ASSERT_EQUAL(*pages.Page(1).begin(), 4);
+    ASSERT(pages.Page(3).begin() == pages.Page(3).end());
+
+    const std::vector<int> empty;
+    ASSERT(Paginate(empty, 2).begin() == Paginate(empty, 2).end());
+
+    SearchServer server("and"s);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, "cat " + std::to_string(id % 10) + "word", DocumentStatus::ACTUAL, { id });
+    }
+    const std::vector<Document> top = server.FindTopDocuments("cat 3word"s);
+
+    // a page ranks the documents up to its end only
+    const SearchResults results = server.FindDocuments("cat 3word"s);
+    ASSERT_EQUAL(results.GetSize(), 100u);
+    ASSERT_EQUAL(results.GetRankedCount(), 0u);
+    const auto first_page = results.Page(0, 5);
+    ASSERT_EQUAL(results.GetRankedCount(), 5u);
+    ASSERT(IsSameRanking(std::vector<Document>(first_page.begin(), first_page.end()), top));
+    const auto third_page = results.Page(2, 10);
+    ASSERT_EQUAL(results.GetRankedCount(), 30u);
+    ASSERT_EQUAL(third_page.begin()->id, 88);
+    ASSERT(results.Page(10, 10).begin() == results.Page(10, 10).end());
+
+    // pages over the lazy forward iterator of the results agree
+    const SearchResults streamed = server.FindDocuments("cat 3word"s, DocumentStatus::ACTUAL);
+    const auto streamed_page = Paginate(streamed, 10).Page(2);
+    ASSERT_EQUAL(streamed_page.begin()->id, 88);
+    ASSERT(streamed.GetRankedCount() < 100u);
+
+    std::vector<Document> all(streamed.begin(), streamed.end());
+    ASSERT_EQUAL(all.size(), 100u);
+    ASSERT(std::is_sorted(all.begin(), all.end(), RanksBefore));
+    ASSERT_EQUAL(server.FindDocuments("cat"s, [](int id, DocumentStatus, int) { return id < 10; }).GetSize(), 10u);
+}
+
+void TestSearchCursor() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 1000; ++id) {
+        // many ties on relevance and rating
+        server.AddDocument(id, "cat " + std::to_string(id % 13) + "word", id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+            { id % 7 });
+    }
+    const SearchResults results = server.FindDocuments("cat 3word 4word"s);
+    const std::vector<Document> expected(results.begin(), results.end());
+    ASSERT_EQUAL(expected.size(), 800u);
+
+    SearchCursor cursor(server, "cat 3word 4word"s, 64);
+    std::vector<Document> streamed;
+    for (std::vector<Document> chunk = cursor.Next(); !chunk.empty(); chunk = cursor.Next()) {
+        ASSERT(chunk.size() == 64u || cursor.IsDone());
+        streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+    }
+    ASSERT(IsSameRanking(streamed, expected));
+    ASSERT(cursor.Next().empty());
+
+    // chunks over several refills of the buffer
+    SearchServer large_server("and"s);
+    for (int id = 0; id < 10000; ++id) {
+        large_server.AddDocument(id, "cat " + std::to_string(id % 13) + "word", DocumentStatus::ACTUAL, { id % 7 });
+    }
+    const SearchResults large_results = large_server.FindDocuments("cat 3word"s);
+    const std::vector<Document> large_expected(large_results.begin(), large_results.end());
+    ASSERT(large_expected.size() > 2 * SearchCursor<>::MIN_REFILL);
+    SearchCursor refilled(large_server, "cat 3word"s, 1000);
+    std::vector<Document> refilled_streamed;
+    for (std::vector<Document> chunk = refilled.Next(); !chunk.empty(); chunk = refilled.Next()) {
+        refilled_streamed.insert(refilled_streamed.end(), chunk.begin(), chunk.end());
+    }
+    ASSERT(IsSameRanking(refilled_streamed, large_expected));
+
+    // changes between chunks are seen by the next one
+    SearchCursor changing(server, "cat 3word 4word"s, 64);
+    const std::vector<Document> first = changing.Next();
+    const int removed_id = expected.back().id;
+    server.RemoveDocument(removed_id);
+    server.AddDocument(1000, "cat dog bird fish"s, DocumentStatus::ACTUAL, { -100 });
+    std::vector<Document> rest;
+    for (std::vector<Document> chunk = changing.Next(); !chunk.empty(); chunk = changing.Next()) {
+        rest.insert(rest.end(), chunk.begin(), chunk.end());
+    }
+    ASSERT_EQUAL(first.size() + rest.size(), 800u);
+    ASSERT(std::is_sorted(rest.begin(), rest.end(), RanksBefore));
+    ASSERT_EQUAL(rest.back().id, 1000);
+    ASSERT(std::none_of(rest.begin(), rest.end(), [removed_id](const Document& document) { return document.id == removed_id; }));
+
+    SearchCursor<Bm25> banned(server, "cat -3word"s, 1000, DocumentStatus::BANNED);
+    const std::vector<Document> chunk = banned.Next();
+    ASSERT_EQUAL(chunk.size(), 185u);
+    ASSERT(banned.IsDone());
+    ASSERT(std::is_sorted(chunk.begin(), chunk.end(), RanksBefore));
+}
+
+void TestTokenizer() {
+    // tabs and new lines as delimiters, UTF-8 words and words across 32 byte blocks
+    std::string text;
+    for (int i = 0; i < 40; ++i) {
+        text += "Cat\t\xD0\x9A\xD0\xBE\xD1\x82 "s + std::string(static_cast<size_t>(i % 37), 'x') + "\n  "s;
+    }
+    const TokenizerOptions scalar_options{ " \t\n"s, true, false };
+    TokenizerOptions simd_options = scalar_options;
+    simd_options.use_simd = true;
+    const Tokenizer scalar(scalar_options);
+    const Tokenizer simd(simd_options);
+
+    // holds the folded copies, which Split never gives back
+    std::pmr::monotonic_buffer_resource folded;
+    std::pmr::vector<std::string_view> scalar_words;
+    std::pmr::vector<std::string_view> simd_words;
+    for (size_t length = 0; length <= text.size(); length += 7) {
+        const std::string_view prefix(text.data(), length);
+        ASSERT(scalar.Split(prefix, scalar_words, &folded));
+        ASSERT(simd.Split(prefix, simd_words, &folded));
+        ASSERT(std::equal(scalar_words.begin(), scalar_words.end(), simd_words.begin(), simd_words.end()));
+    }
+    ASSERT_EQUAL(simd_words.front(), "cat"sv);
+    ASSERT_EQUAL(simd_words[1], "\xD0\x9A\xD0\xBE\xD1\x82"sv);
+
+    // a control character which is not a delimiter, far from the beginning
+    const std::string invalid = text + "dog\x01"s;
+    ASSERT(!scalar.Split(invalid, scalar_words, &folded));
+    ASSERT(!simd.Split(invalid, simd_words, &folded));
+
+    SearchServer server("The"s, TokenizerOptions{ " \t\n.,"s, true });
+    server.AddDocument(1, "The Cat,\tthe dog."s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "a BIRD\nand a cat"s, DocumentStatus::ACTUAL, { 2 });
+    const std::vector<Document> found = server.FindTopDocuments("CAT -bird the"s);
+    ASSERT_EQUAL(found.size(), 1u);
+    ASSERT_EQUAL(found[0].id, 1);
+    ASSERT_EQUAL(server.GetWordFrequencies(1).size(), 2u);
+}
+
+void TestStopWordFilter() {
+    std::vector<std::string> words;
+    for (int i = 0; i < 500; ++i) {
+        words.push_back("w"s + std::to_string(i * 7919));
+    }
+    words.push_back("w0"s);
+    const StopWordFilter filter = StopWordFilter::Of(words);
+    ASSERT_EQUAL(filter.GetSize(), 500u);
+    for (const std::string& word : words) {
+        ASSERT(filter.Contains(word));
+    }
+    for (int i = 0; i < 500; ++i) {
+        // the same lengths, not in the set
+        ASSERT(!filter.Contains("x"s + std::to_string(i * 7919)));
+        ASSERT(!filter.Contains("w"s + std::to_string(i * 7919 + 1)));
+    }
+    ASSERT(!filter.Contains(""sv));
+    ASSERT(!filter.Contains("w"sv));
+
+    const StopWordFilter empty;
+    ASSERT(empty.IsEmpty());
+    ASSERT(!empty.Contains("w0"sv));
+    ASSERT(!empty.Contains(""sv));
+
+    const StopWordFilter single = StopWordFilter::Of(std::vector<std::string>{ "in"s });
+    ASSERT(single.Contains("in"sv));
+    ASSERT(!single.Contains("on"sv));
+}
+
+void TestPatternQueries() {
+    SearchServer server("and"s);
+    // off by default: '*' and '?' are bytes of the word
+    server.AddDocument(6, "what? *star* ?"s, DocumentStatus::ACTUAL, { 6 });
+    for (const std::string& query : { "what?"s, "*star*"s, "?"s }) {
+        const std::vector<Document> literal = server.FindTopDocuments(query);
+        ASSERT_EQUAL(literal.size(), 1u);
+        ASSERT_EQUAL(literal[0].id, 6);
+    }
+    ASSERT_EQUAL(server.GetQueryKey("pet* -p?t"s), "pet* -p?t "s);
+    server.RemoveDocument(6);
+
+    server.SetQuerySyntax({ .patterns = true });
+    ASSERT(server.GetQuerySyntax().patterns);
+    server.AddDocument(1, "pet shop"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "petal garden"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "carpet cleaning"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "peter and pan"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "pat the cat"s, DocumentStatus::ACTUAL, { 5 });
+
+    const auto ids = [&server](const std::string& query) {
+        std::set<int> result;
+        for (const Document& document : server.FindTopDocuments(query)) {
+            result.insert(document.id);
+        }
+        return result;
+    };
+    ASSERT(ids("pet*"s) == std::set<int>({ 1, 2, 4 }));
+    ASSERT(ids("p?t"s) == std::set<int>({ 1, 5 }));
+    ASSERT(ids("pet*l"s) == std::set<int>({ 2 }));
+    ASSERT(ids("p*t*r"s) == std::set<int>({ 4 }));
+    ASSERT(ids("garden -pet*"s).empty());
+    ASSERT(ids("dog*"s).empty());
+
+    ASSERT(std::get<0>(server.MatchDocument("pet* shop"s, 1)) == std::vector<std::string>({ "pet"s, "shop"s }));
+    ASSERT(std::get<0>(server.MatchDocument("pet*"s, 2)) == std::vector<std::string>({ "petal"s }));
+    ASSERT_EQUAL(server.GetQueryKey("pet* -p?t"s), "pet petal peter -pat -pet "s);
+
+    // a pattern without a literal prefix would try every word
+    for (const std::string& query : { "*pet"s, "?"s, "-*"s }) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "a leading wildcard must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+    // a trailing '?' is a wildcard too
+    ASSERT(ids("pe?"s) == std::set<int>({ 1 }));
+
+    for (int i = 0; i < 100; ++i) {
+        const std::string number = std::to_string(i);
+        server.AddDocument(100 + i, "w"s + std::string(3 - number.size(), '0') + number, DocumentStatus::ACTUAL, { 1 });
+    }
+    const SearchResults results = server.FindDocuments("w*"s);
+    ASSERT_EQUAL(results.GetSize(), SearchServer::MAX_PATTERN_EXPANSIONS);
+    for (const Document& document : results) {
+        ASSERT(document.id < 100 + static_cast<int>(SearchServer::MAX_PATTERN_EXPANSIONS));
+    }
+}
+
+void TestFuzzyQueries() {
+    SearchServer server("and"s);
+    // off by default: '~' and the digit are bytes of the word
+    server.AddDocument(6, "word~9 ~ x~1"s, DocumentStatus::ACTUAL, { 6 });
+    for (const std::string& query : { "word~9"s, "~"s, "x~1"s }) {
+        const std::vector<Document> literal = server.FindTopDocuments(query);
+        ASSERT_EQUAL(literal.size(), 1u);
+        ASSERT_EQUAL(literal[0].id, 6);
+    }
+    ASSERT(server.FindTopDocuments("x~1 -~"s).empty());
+    server.RemoveDocument(6);
+
+    server.SetQuerySyntax({ .patterns = true, .fuzzy = true });
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cart"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "coat"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "cats and dogs"s, DocumentStatus::ACTUAL, { 5 });
+
+    ASSERT(server.FindTopDocuments("cta"s).empty());
+    const std::vector<Document> typo = server.FindTopDocuments("cst~1"s);
+    ASSERT_EQUAL(typo.size(), 1u);
+    ASSERT_EQUAL(typo[0].id, 1);
+
+    // the exact word first, the variants at a discount
+    const std::vector<Document> found = server.FindTopDocuments("cat~1"s);
+    ASSERT_EQUAL(found.size(), 4u);
+    ASSERT_EQUAL(found[0].id, 1);
+    ASSERT(std::abs(found[1].relevance - found[0].relevance * SearchServer::FUZZY_DISCOUNT) < 1e-9);
+    ASSERT_EQUAL(server.FindTopDocuments("cat~"s).size(), 4u);
+
+    ASSERT_EQUAL(server.GetQueryKey("cat~1 -dog~1"s), "cart~1 cat cats~1 coat~1 -dog -dogs "s);
+    ASSERT(std::get<0>(server.MatchDocument("cat~1"s, 2)) == std::vector<std::string>({ "cart"s }));
+    for (const std::string& query : { "cat~3"s, "ca*~1"s, "~1"s, "~"s, "-~"s, "word~9"s }) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "invalid fuzzy word "s + query);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+    // ~ followed by anything but a digit is part of a literal word
+    server.AddDocument(7, "a~b x~y"s, DocumentStatus::ACTUAL, { 7 });
+    for (const std::string& query : { "a~b"s, "x~y -dog"s }) {
+        const std::vector<Document> literal = server.FindTopDocuments(query);
+        ASSERT_EQUAL(literal.size(), 1u);
+        ASSERT_EQUAL(literal[0].id, 7);
+    }
+    ASSERT_EQUAL(server.GetQueryKey("a~b"s), "a~b "s);
+
+    // the walk over the dictionary finds what a comparison with every word finds
+    const auto distance = [](const std::string& lhs, const std::string& rhs) {
+        std::vector<size_t> row(rhs.size() + 1);
+        std::iota(row.begin(), row.end(), 0);
+        for (size_t i = 1; i <= lhs.size(); ++i) {
+            size_t diagonal = row[0];
+            row[0] = i;
+            for (size_t j = 1; j <= rhs.size(); ++j) {
+                const size_t above = row[j];
+                row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (lhs[i - 1] == rhs[j - 1] ? 0 : 1) });
+                diagonal = above;
+            }
+        }
+        return row.back();
+    };
+    std::mt19937 generator(7);
+    std::set<std::string> dictionary;
+    SearchServer random_server(""s);
+    random_server.SetQuerySyntax({ .fuzzy = true });
+    for (int id = 0; id < 3000; ++id) {
+        std::string word(3 + generator() % 5, 'a');
+        for (char& c : word) {
+            c = static_cast<char>('a' + generator() % 8);
+        }
+        dictionary.insert(word);
+        random_server.AddDocument(id, word, DocumentStatus::ACTUAL, { 1 });
+    }
+    for (int i = 0; i < 50; ++i) {
+        const std::string& word = *std::next(dictionary.begin(), static_cast<long>(generator() % dictionary.size()));
+        const std::string query = word.substr(1) + "~1"s;
+        std::string expected;
+        size_t expected_count = 0;
+        for (const std::string& candidate : dictionary) {
+            const size_t edits = distance(candidate, word.substr(1));
+            if (edits <= 1) {
+                expected += candidate + (edits == 0 ? ""s : "~1"s) + " "s;
+                ++expected_count;
+            }
+        }
+        if (expected_count <= SearchServer::MAX_FUZZY_EXPANSIONS) {
+            ASSERT_EQUAL(random_server.GetQueryKey(query), expected);
+        }
+    }
+}
+
+void TestExternalIndex() {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "search_server_external_index_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path index_path = directory / "corpus.idx";
+
+    const std::vector<std::string> vocabulary = { "cat"s, "dog"s, "fluffy"s, "tail"s, "collar"s, "and"s, "in"s,
+        "eyes"s, "bird"s, "fish"s, "park"s, "white"s, "black"s, "groomed"s, "starling"s, "evgeny"s };
+    std::mt19937 generator(11);
+    SearchServer server("and in"s);
+    {
+        // a tiny budget spills a run every few documents
+        ExternalIndexOptions options;
+        options.memory_budget = 1024;
+        ExternalIndexBuilder builder(index_path, "and in"s, options);
+        for (int id = 0; id < 300; ++id) {
+            std::string document;
+            for (size_t i = 0; i < 3 + generator() % 10; ++i) {
+                document += vocabulary[generator() % vocabulary.size()] + " "s;
+            }
+            const DocumentStatus status = id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            const std::vector<int> ratings = { static_cast<int>(generator() % 10), id % 5 };
+            // ids out of order, so that runs must be merged by id
+            const int document_id = (id * 37) % 300;
+            server.AddDocument(document_id, document, status, ratings);
+            builder.AddDocument(document_id, document, status, ratings);
+        }
+        ASSERT(builder.GetRunCount() > 1);
+        builder.Finish();
+    }
+    // the runs are removed
+    ASSERT_EQUAL(static_cast<size_t>(std::distance(std::filesystem::directory_iterator(directory),
+        std::filesystem::directory_iterator())), 1u);
+
+    const ExternalIndex index(index_path);
+    ASSERT_EQUAL(index.GetDocumentCount(), 300u);
+    ASSERT_EQUAL(index.GetCollectionStatistics().average_length, server.GetCollectionStatistics().average_length);
+    for (const std::string& query : { "cat"s, "fluffy cat -collar"s, "bird fish park white black"s, "and"s, "mouse"s }) {
+        ASSERT(IsSameRanking(index.FindTopDocuments(query), server.FindTopDocuments(query)));
+        ASSERT(IsSameRanking(index.FindTopDocuments<Bm25>(query), server.FindTopDocuments<Bm25>(query)));
+        ASSERT(IsSameRanking(index.FindTopDocuments(query, DocumentStatus::BANNED),
+            server.FindTopDocuments(query, DocumentStatus::BANNED)));
+    }
+    try {
+        index.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "an invalid query must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // in one run of documents, then in two runs merged
+    for (const size_t memory_budget : { size_t{ 64 << 20 }, sizeof(index_file::DocumentRecord) }) {
+        ExternalIndexOptions options;
+        options.memory_budget = memory_budget;
+        ExternalIndexBuilder builder(directory / "duplicates.idx", ""s, options);
+        builder.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {});
+        builder.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, {});
+        try {
+            builder.Finish();
+            ASSERT_HINT(false, "a repeated id must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+    {
+        std::ofstream(directory / "invalid.idx") << "not an index"s;
+        try {
+            const ExternalIndex invalid(directory / "invalid.idx");
+            ASSERT_HINT(false, "an invalid file must be rejected"s);
+        }
+        catch (const std::runtime_error&) {
+        }
+    }
+    {
+        // damaged copies of a valid file; the header size is kept consistent, so only the offsets tell
+        std::ifstream input(index_path, std::ios::binary);
+        const std::string valid((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        index_file::Header header;
+        std::memcpy(&header, valid.data(), sizeof(header));
+        ASSERT(header.term_count > 0);
+
+        const auto is_rejected = [&directory](std::string bytes, const auto& damage) {
+            index_file::Header damaged;
+            std::memcpy(&damaged, bytes.data(), sizeof(damaged));
+            damage(bytes, damaged);
+            std::memcpy(bytes.data(), &damaged, sizeof(damaged));
+            std::ofstream(directory / "damaged.idx", std::ios::binary | std::ios::trunc) << bytes;
+            try {
+                const ExternalIndex damaged_index(directory / "damaged.idx");
+                return false;
+            }
+            catch (const std::runtime_error&) {
+                return true;
+            }
+            };
+        const auto term_of = [&header](std::string& bytes, uint64_t i) {
+            return reinterpret_cast<index_file::TermRecord*>(bytes.data() + header.terms_offset) + i;
+            };
+        ASSERT(!is_rejected(valid, [](std::string&, index_file::Header&) {}));
+        // truncated in the words of the last terms
+        ASSERT(is_rejected(valid, [](std::string& bytes, index_file::Header& damaged) {
+            bytes.resize(bytes.size() - 4);
+            damaged.file_size = bytes.size();
+            }));
+        // truncated before the terms
+        ASSERT(is_rejected(valid, [](std::string& bytes, index_file::Header& damaged) {
+            bytes.resize(damaged.terms_offset);
+            damaged.file_size = bytes.size();
+            }));
+        ASSERT(is_rejected(valid, [](std::string&, index_file::Header& damaged) {
+            damaged.document_count = UINT64_MAX / sizeof(index_file::DocumentRecord) + 2;
+            }));
+        ASSERT(is_rejected(valid, [](std::string&, index_file::Header& damaged) {
+            damaged.documents_offset = damaged.file_size;
+            }));
+        ASSERT(is_rejected(valid, [](std::string&, index_file::Header& damaged) {
+            damaged.term_count += 1;
+            }));
+        ASSERT(is_rejected(valid, [&term_of](std::string& bytes, index_file::Header&) {
+            term_of(bytes, 0)->postings_offset = UINT64_MAX - 7;
+            }));
+        ASSERT(is_rejected(valid, [&term_of, &header](std::string& bytes, index_file::Header&) {
+            // the postings of the last term run into the terms
+            term_of(bytes, header.term_count - 1)->document_freq += 1;
+            }));
+        ASSERT(is_rejected(valid, [&term_of](std::string& bytes, index_file::Header&) {
+            term_of(bytes, 0)->postings_offset += 4;
+            }));
+        ASSERT(is_rejected(valid, [&term_of](std::string& bytes, index_file::Header&) {
+            term_of(bytes, 0)->string_length = UINT32_MAX;
+            }));
+
+        // a posting of a document not in the table is found by the search
+        std::string bytes = valid;
+        const index_file::TermRecord& cat = *std::find_if(term_of(bytes, 0), term_of(bytes, header.term_count),
+            [&bytes, &header](const index_file::TermRecord& term) {
+                return std::string_view(bytes.data() + header.strings_offset + term.string_offset, term.string_length) == "cat"sv;
+            });
+        const int32_t unknown_id = 1000;
+        std::memcpy(bytes.data() + cat.postings_offset + (cat.document_freq - 1) * sizeof(int32_t), &unknown_id, sizeof(unknown_id));
+        std::ofstream(directory / "damaged.idx", std::ios::binary | std::ios::trunc) << bytes;
+        const ExternalIndex damaged_index(directory / "damaged.idx");
+        try {
+            damaged_index.FindTopDocuments("cat"s);
+            ASSERT_HINT(false, "a posting of an unknown document must be rejected"s);
+        }
+        catch (const std::runtime_error&) {
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+void TestMemoryStats() {
+    for (const IndexAllocation allocation : { IndexAllocation::HEAP, IndexAllocation::POOL }) {
+        SearchServer server("and in on"s, allocation);
+        const IndexMemoryStats empty = server.MemoryStats();
+        ASSERT_EQUAL(empty.term_dictionary + empty.postings + empty.forward_index + empty.document_metadata, 0u);
+        ASSERT(empty.stop_words > 0);
+        ASSERT_EQUAL(empty.per_document, 0.0);
+
+        for (int id = 0; id < 100; ++id) {
+            server.AddDocument(id, "cat dog and "s + std::to_string(id) + "word"s, DocumentStatus::ACTUAL, { 1 });
+        }
+        const IndexMemoryStats stats = server.MemoryStats();
+        ASSERT(stats.term_dictionary > 0 && stats.postings > 0 && stats.forward_index > 0 && stats.document_metadata > 0);
+        ASSERT_EQUAL(stats.total,
+            stats.term_dictionary + stats.postings + stats.forward_index + stats.document_metadata + stats.stop_words);
+        ASSERT(stats.heap + stats.stop_words >= stats.total);
+        ASSERT(stats.peak_heap >= stats.heap);
+        ASSERT_EQUAL(stats.per_document, stats.total / 100.0);
+        // a word per document: 102 words, 300 postings
+        ASSERT(stats.postings >= 300 * (sizeof(uint32_t) + sizeof(double)));
+
+        // new postings of known words grow the postings, not the dictionary
+        server.AddDocument(100, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_EQUAL(server.MemoryStats().term_dictionary, stats.term_dictionary);
+
+        for (int id = 0; id <= 100; ++id) {
+            server.RemoveDocument(id);
+        }
+        const IndexMemoryStats removed = server.MemoryStats();
+        ASSERT_EQUAL(removed.total, removed.stop_words);
+        if (allocation == IndexAllocation::HEAP) {
+            ASSERT_EQUAL(removed.heap, 0u);
+        }
+    }
+}
+
+void TestOptionalForwardIndex() {
+    SearchServer full("and in"s);
+    SearchServer query_only("and in"s, IndexAllocation::HEAP, ForwardIndex::NONE);
+    for (SearchServer* server : { &full, &query_only }) {
+        server->AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+        server->AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        server->AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+        server->AddDocument(4, "groomed starling eugene"s, DocumentStatus::BANNED, { 9 });
+    }
+    ASSERT(query_only.GetForwardIndex() == ForwardIndex::NONE);
+    ASSERT(query_only.GetWordFrequencies(2).empty());
+    ASSERT_EQUAL(full.GetWordFrequencies(2).size(), 3u);
+
+    const std::vector<std::string> queries = { "fluffy groomed cat"s, "cat -collar"s, "starling"s, "eyes -dog"s };
+    for (const std::string& query : queries) {
+        ASSERT(IsSameRanking(query_only.FindTopDocuments(query), full.FindTopDocuments(query)));
+        for (int id = 1; id <= 4; ++id) {
+            ASSERT(query_only.MatchDocument(query, id) == full.MatchDocument(query, id));
+        }
+    }
+    try {
+        query_only.MatchDocument("cat"s, 5);
+        ASSERT_HINT(false, "an unknown document must be rejected"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+
+    const IndexMemoryStats full_stats = full.MemoryStats();
+    const IndexMemoryStats query_only_stats = query_only.MemoryStats();
+    ASSERT(full_stats.forward_index > 0);
+    ASSERT_EQUAL(query_only_stats.forward_index, 0u);
+    ASSERT_EQUAL(query_only_stats.total + full_stats.forward_index, full_stats.total);
+
+    // removal searches every posting, with the same outcome
+    for (SearchServer* server : { &full, &query_only }) {
+        server->RemoveDocument(2);
+    }
+    for (const std::string& query : queries) {
+        ASSERT(IsSameRanking(query_only.FindTopDocuments(query), full.FindTopDocuments(query)));
+    }
+    ASSERT(query_only.FindTopDocuments("fluffy"s).empty());
+    ASSERT_EQUAL(query_only.MemoryStats().term_dictionary, full.MemoryStats().term_dictionary);
+
+    full.DropForwardIndex();
+    ASSERT(full.GetForwardIndex() == ForwardIndex::NONE);
+    ASSERT_EQUAL(full.MemoryStats().forward_index, 0u);
+    full.RemoveDocument(1);
+    ASSERT(full.FindTopDocuments("collar"s).empty());
+
+
+    // duplicates are found by their signatures instead, the lowest id kept
+    for (SearchServer* server : { &full, &query_only }) {
+        server->AddDocument(5, "eyes expressive dog groomed dog"s, DocumentStatus::ACTUAL, { 1 });
+        server->AddDocument(6, "starling eugene groomed"s, DocumentStatus::ACTUAL, { 1 });
+        server->AddDocument(0, "starling groomed and eugene"s, DocumentStatus::ACTUAL, { 1 });
+        RemoveDuplicates(*server);
+    }
+    ASSERT(query_only.GetDeduplication() == Deduplication::OFF);
+    ASSERT(std::vector<int>(query_only.begin(), query_only.end()) == std::vector<int>({ 0, 1, 3 }));
+    ASSERT(std::vector<int>(full.begin(), full.end()) == std::vector<int>({ 0, 3 }));
+}
+
+void TestIngestDeduplication() {
+    const std::vector<std::pair<int, std::string>> documents = {
+        { 1, "funny pet and nasty rat"s },
+        { 2, "funny pet with curly hair"s },
+        // the words of 2, repeated, in another order and with a stop word
+        { 3, "curly hair and funny funny pet with"s },
+        { 4, "nasty rat funny pet"s },
+        { 5, "funny pet"s },
+    };
+
+    SearchServer rejecting("and"s);
+    rejecting.SetDeduplication(Deduplication::REJECT);
+    ASSERT(rejecting.GetDeduplication() == Deduplication::REJECT);
+    std::vector<int> added;
+    for (const auto& [id, text] : documents) {
+        if (rejecting.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 })) {
+            added.push_back(id);
+        }
+    }
+    ASSERT(added == std::vector<int>({ 1, 2, 5 }));
+    ASSERT(rejecting.GetWordFrequencies(3).empty());
+    ASSERT(rejecting.GetDuplicates().empty());
+    // the signature goes with the document
+    rejecting.RemoveDocument(2);
+    ASSERT(rejecting.AddDocument(3, documents[2].second, DocumentStatus::ACTUAL, { 1 }));
+    ASSERT(!rejecting.AddDocument(2, documents[1].second, DocumentStatus::ACTUAL, { 1 }));
+
+    // recorded, then removed without the forward index
+    SearchServer recording("and"s, IndexAllocation::HEAP, ForwardIndex::NONE);
+    recording.SetDeduplication(Deduplication::RECORD);
+    for (const auto& [id, text] : documents) {
+        ASSERT(recording.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 }));
+    }
+    ASSERT(recording.GetDuplicates() == std::vector<int>({ 3, 4 }));
+    RemoveDuplicates(recording);
+    ASSERT(std::vector<int>(recording.begin(), recording.end()) == std::vector<int>({ 1, 2, 5 }));
+    ASSERT(recording.GetDuplicates().empty());
+
+    // the lowest id is kept, whichever came first
+    ASSERT(recording.AddDocument(0, "rat nasty pet funny"s, DocumentStatus::ACTUAL, { 1 }));
+    ASSERT(recording.GetDuplicates() == std::vector<int>({ 1 }));
+
+    // signed after the fact, as the pairwise pass finds them
+    SearchServer signed_late("and"s);
+    SearchServer pairwise("and"s);
+    for (const auto& [id, text] : documents) {
+        signed_late.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+        pairwise.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+    }
+    signed_late.AddDocument(6, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    pairwise.AddDocument(6, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    signed_late.RemoveDocument(1);
+    pairwise.RemoveDocument(1);
+    signed_late.SetDeduplication(Deduplication::REJECT);
+    ASSERT(signed_late.GetDuplicates() == std::vector<int>({ 3, 6 }));
+    RemoveDuplicates(signed_late);
+    RemoveDuplicates(pairwise);
+    ASSERT(std::vector<int>(signed_late.begin(), signed_late.end()) == std::vector<int>(pairwise.begin(), pairwise.end()));
+    ASSERT(!signed_late.AddDocument(7, "rat funny nasty pet"s, DocumentStatus::ACTUAL, { 1 }));
+
+    signed_late.SetDeduplication(Deduplication::OFF);
+    ASSERT(signed_late.AddDocument(7, "rat funny nasty pet"s, DocumentStatus::ACTUAL, { 1 }));
+    ASSERT(signed_late.GetDuplicates().empty());
+}
+
+void TestShardDeduplication() {
+    std::vector<SearchServer> shards;
+    shards.emplace_back("and"s);
+    shards.emplace_back("and"s, IndexAllocation::HEAP, ForwardIndex::NONE);
+    shards.emplace_back("and"s);
+    shards[2].SetDeduplication(Deduplication::RECORD);
+
+    shards[0].AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1 });
+    shards[0].AddDocument(4, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1 });
+    shards[1].AddDocument(2, "rat nasty pet funny"s, DocumentStatus::ACTUAL, { 1 });
+    shards[1].AddDocument(3, "curly hair funny pet with with"s, DocumentStatus::ACTUAL, { 1 });
+    shards[1].AddDocument(5, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    shards[2].AddDocument(6, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    shards[2].AddDocument(7, "pet and funny"s, DocumentStatus::ACTUAL, { 1 });
+    shards[2].AddDocument(8, "big dog"s, DocumentStatus::ACTUAL, { 1 });
+
+    ThreadPool pool(2, 4);
+    // 4 goes, not 3: the lowest id is kept wherever it is
+    ASSERT(RemoveDuplicates(pool, shards) == std::vector<int>({ 2, 4, 6, 7 }));
+    ASSERT(std::vector<int>(shards[0].begin(), shards[0].end()) == std::vector<int>({ 1 }));
+    ASSERT(std::vector<int>(shards[1].begin(), shards[1].end()) == std::vector<int>({ 3, 5 }));
+    ASSERT(std::vector<int>(shards[2].begin(), shards[2].end()) == std::vector<int>({ 8 }));
+    ASSERT(shards[2].GetDuplicates().empty());
+    ASSERT(RemoveDuplicates(pool, shards).empty());
+
+    // against the sets of words of documents spread over shards of every kind
+    std::vector<SearchServer> random_shards;
+    for (int shard = 0; shard < 4; ++shard) {
+        random_shards.emplace_back(""s, IndexAllocation::HEAP, shard % 2 == 0 ? ForwardIndex::FULL : ForwardIndex::NONE);
+    }
+    random_shards[3].SetDeduplication(Deduplication::RECORD);
+    const std::vector<std::string> vocabulary = { "a"s, "b"s, "c"s, "d"s, "e"s, "f"s };
+    std::mt19937 generator(7);
+    std::set<std::set<std::string>> seen;
+    std::vector<int> expected;
+    for (int id = 0; id < 300; ++id) {
+        std::string text;
+        std::set<std::string> words;
+        for (int i = 1 + generator() % 3; i > 0; --i) {
+            const std::string& word = vocabulary[generator() % vocabulary.size()];
+            text += word + " "s;
+            words.insert(word);
+        }
+        random_shards[generator() % random_shards.size()].AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+        if (!seen.insert(words).second) {
+            expected.push_back(id);
+        }
+    }
+    ASSERT(RemoveDuplicates(pool, random_shards) == expected);
+    size_t remaining = 0;
+    for (const SearchServer& shard : random_shards) {
+        remaining += shard.GetDocumentCount();
+    }
+    ASSERT_EQUAL(remaining, seen.size());
+}
+
+// Recursive descent over one JSON value; pos ends past it
+bool ParseJsonValue(std::string_view json, size_t& pos) {
+    const auto skip_spaces = [&json, &pos] {
+        while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\t' || json[pos] == '\r')) {
+            ++pos;
+        }
+        };
+    const auto parse_string = [&json, &pos] {
+        if (pos >= json.size() || json[pos] != '"') {
+            return false;
+        }
+        for (++pos; pos < json.size() && json[pos] != '"'; ++pos) {
+            if (static_cast<unsigned char>(json[pos]) < ' ') {
+                return false;
+            }
+            if (json[pos] == '\\') {
+                ++pos;
+            }
+        }
+        return pos++ < json.size();
+        };
+    skip_spaces();
+    if (pos >= json.size()) {
+        return false;
+    }
+    if (json[pos] == '{' || json[pos] == '[') {
+        const char close = json[pos] == '{' ? '}' : ']';
+        const bool is_object = close == '}';
+        ++pos;
+        skip_spaces();
+        if (pos < json.size() && json[pos] == close) {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            if (is_object) {
+                skip_spaces();
+                if (!parse_string()) {
+                    return false;
+                }
+                skip_spaces();
+                if (pos >= json.size() || json[pos++] != ':') {
+                    return false;
+                }
+            }
+            if (!ParseJsonValue(json, pos)) {
+                return false;
+            }
+            skip_spaces();
+            if (pos < json.size() && json[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            return pos < json.size() && json[pos++] == close;
+        }
+    }
+    if (json[pos] == '"') {
+        return parse_string();
+    }
+    // numbers and literals, loosely
+    const size_t begin = pos;
+    while (pos < json.size() && std::string_view("+-.0123456789eEtruefalsn").find(json[pos]) != std::string_view::npos) {
+        ++pos;
+    }
+    return pos > begin;
+}
+
+bool IsWellFormedJson(std::string_view json) {
+    size_t pos = 0;
+    if (!ParseJsonValue(json, pos)) {
+        return false;
+    }
+    return json.find_first_not_of(" \n\t\r", pos) == std::string_view::npos;
+}
+
+void TestProfiler() {
+    ASSERT(IsWellFormedJson(R"({"a": [1, 2.5, "x\"y"], "b": {}})"sv));
+    ASSERT(!IsWellFormedJson(R"({"a": [1, 2,]})"sv));
+    ASSERT(!IsWellFormedJson(R"({"a": 1} })"sv));
+
+    // ProfileScope directly: PROFILE_SCOPE is compiled out unless SEARCH_SERVER_PROFILE is defined
+    Profiler::Reset();
+    for (int i = 0; i < 3; ++i) {
+        ProfileScope outer("test \"outer\"");
+        for (int j = 0; j < 2; ++j) {
+            ProfileScope inner("test inner");
+        }
+    }
+    {
+        ProfileScope alone("test inner");
+    }
+
+    std::ostringstream summary;
+    Profiler::PrintSummary(summary);
+    // "path: calls, total/min/p50/p99/max" by path
+    std::map<std::string, std::vector<uint64_t>> paths;
+    std::istringstream lines(summary.str());
+    std::string line;
+    std::getline(lines, line);
+    ASSERT_EQUAL(line, "path: calls, total/min/p50/p99/max ns"s);
+    while (std::getline(lines, line)) {
+        const size_t colon = line.rfind(": ");
+        std::vector<uint64_t> numbers;
+        std::istringstream values(line.substr(colon + 2));
+        for (uint64_t value = 0; values >> value; values.ignore(1)) {
+            numbers.push_back(value);
+        }
+        ASSERT_EQUAL(numbers.size(), 6u);
+        paths[line.substr(0, colon)] = numbers;
+    }
+    ASSERT_EQUAL(paths.size(), 3u);
+    ASSERT_EQUAL(paths.at("test \"outer\""s)[0], 3u);
+    ASSERT_EQUAL(paths.at("test \"outer\" > test inner"s)[0], 6u);
+    ASSERT_EQUAL(paths.at("test inner"s)[0], 1u);
+    for (const auto& [path, numbers] : paths) {
+        const uint64_t calls = numbers[0];
+        const uint64_t total = numbers[1];
+        ASSERT_HINT(numbers[2] <= numbers[3] && numbers[3] <= numbers[4] && numbers[4] <= numbers[5], path);
+        ASSERT_HINT(total >= numbers[5] && total >= calls * numbers[2] && total <= calls * numbers[5], path);
+    }
+    // the children run within their parents
+    ASSERT(paths.at("test \"outer\""s)[1] >= paths.at("test \"outer\" > test inner"s)[1]);
+
+    std::ostringstream trace;
+    Profiler::WriteChromeTrace(trace);
+    ASSERT(IsWellFormedJson(trace.str()));
+    size_t events = 0;
+    for (size_t pos = trace.str().find("\"ph\": \"X\""); pos != std::string::npos; pos = trace.str().find("\"ph\": \"X\"", pos + 1)) {
+        ++events;
+    }
+    ASSERT_EQUAL(events, 10u);
+    ASSERT(trace.str().find(R"("name": "test \"outer\"")") != std::string::npos);
+
+    // the buffer of an exited thread goes to the next one, its events kept
+    Profiler::Reset();
+    Profiler::GetThreadBuffer();
+    const size_t buffer_count = Profiler::GetThreadBufferCount();
+    for (int i = 0; i < 8; ++i) {
+        std::thread([] {
+            ProfileScope scope("test thread");
+            }).join();
+    }
+    ASSERT(Profiler::GetThreadBufferCount() <= buffer_count + 1);
+    std::ostringstream thread_summary;
+    Profiler::PrintSummary(thread_summary);
+    ASSERT(thread_summary.str().find("\ntest thread: 8, "s) != std::string::npos);
+
+#ifdef SEARCH_SERVER_PROFILE
+    // the scopes of the server, nested as they are called
+    Profiler::Reset();
+    SearchServer server("and"s);
+    server.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.FindTopDocuments("cat"s);
+    std::ostringstream server_summary;
+    Profiler::PrintSummary(server_summary);
+    ASSERT(server_summary.str().find("\nAddDocument: 1, "s) != std::string::npos);
+    ASSERT(server_summary.str().find("\nFindTopDocuments > FindAllDocuments: 1, "s) != std::string::npos);
+#endif
+
+    Profiler::Reset();
+    std::ostringstream empty_trace;
+    Profiler::WriteChromeTrace(empty_trace);
+    ASSERT(IsWellFormedJson(empty_trace.str()));
+}
+
+void TestLatencyHistogram() {
+    // exact below 2 * SUB_BUCKET_COUNT, then within 1 / SUB_BUCKET_COUNT of the value
+    for (uint64_t value = 0; value < 2 * LatencyHistogram::SUB_BUCKET_COUNT; ++value) {
+        ASSERT_EQUAL(LatencyHistogram::BucketIndex(value), value);
+        ASSERT_EQUAL(LatencyHistogram::BucketLowerBound(value), value);
+    }
+    ASSERT_EQUAL(LatencyHistogram::BucketLowerBound(LatencyHistogram::BucketIndex(65)), 64u);
+    ASSERT_EQUAL(LatencyHistogram::BucketLowerBound(LatencyHistogram::BucketIndex(101)), 100u);
+    ASSERT_EQUAL(LatencyHistogram::BucketLowerBound(LatencyHistogram::BucketIndex(1000)), 992u);
+    for (uint64_t value = 64; value <= LatencyHistogram::MAX_VALUE; value = value * 3 / 2 + 7) {
+        const size_t index = LatencyHistogram::BucketIndex(value);
+        const uint64_t lower_bound = LatencyHistogram::BucketLowerBound(index);
+        ASSERT(index < LatencyHistogram::BUCKET_COUNT);
+        ASSERT(lower_bound <= value && value - lower_bound < lower_bound / LatencyHistogram::SUB_BUCKET_COUNT);
+        // the next bucket starts past the value
+        ASSERT(LatencyHistogram::BucketLowerBound(index + 1) > value);
+    }
+    // clamped
+    ASSERT_EQUAL(LatencyHistogram::BucketIndex(LatencyHistogram::MAX_VALUE * 8), LatencyHistogram::BucketIndex(LatencyHistogram::MAX_VALUE));
+    ASSERT_EQUAL(LatencyHistogram::BucketIndex(LatencyHistogram::MAX_VALUE), LatencyHistogram::BUCKET_COUNT - 1);
+
+    // 1..100: ranks are the values, up to the 2 ns buckets above 63
+    LatencyHistogram uniform;
+    ASSERT_EQUAL(uniform.GetValueAtQuantile(0.5), 0u);
+    for (uint64_t value = 1; value <= 100; ++value) {
+        uniform.Record(value);
+    }
+    ASSERT_EQUAL(uniform.GetCount(), 100u);
+    ASSERT_EQUAL(uniform.GetMax(), 100u);
+    ASSERT(is_equal(uniform.GetMean(), 50.5));
+    ASSERT_EQUAL(uniform.GetValueAtQuantile(0.0), 1u);
+    ASSERT_EQUAL(uniform.GetValueAtQuantile(0.5), 50u);
+    ASSERT_EQUAL(uniform.GetValueAtQuantile(0.99), 98u);
+    ASSERT_EQUAL(uniform.GetValueAtQuantile(1.0), 100u);
+
+    // a slow tail of 1%: p99 is still fast, p999 is in the tail
+    LatencyHistogram tail;
+    for (int i = 0; i < 1000; ++i) {
+        tail.Record(1000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        tail.Record(1'000'000);
+    }
+    ASSERT_EQUAL(tail.GetValueAtQuantile(0.5), 992u);
+    ASSERT_EQUAL(tail.GetValueAtQuantile(0.99), 992u);
+    ASSERT_EQUAL(tail.GetValueAtQuantile(0.999), LatencyHistogram::BucketLowerBound(LatencyHistogram::BucketIndex(1'000'000)));
+    ASSERT(tail.GetValueAtQuantile(0.999) > 970'000u);
+
+    // 10 requests a second; the rate is over the last minute, or since the first request
+    using Clock = RequestStatistics::Clock;
+    const Clock::time_point start = Clock::time_point() + std::chrono::hours(1);
+    RequestStatistics statistics;
+    ASSERT(is_equal(statistics.GetQps(start), 0.0));
+    for (int second = 0; second < 90; ++second) {
+        for (int i = 0; i < 10; ++i) {
+            const Clock::time_point now = start + std::chrono::seconds(second) + std::chrono::milliseconds(i * 100);
+            statistics.Record(now, std::chrono::microseconds(i == 0 ? 900 : 100), static_cast<size_t>(i));
+        }
+        if (second == 29) {
+            ASSERT(is_equal(statistics.GetQps(start + std::chrono::milliseconds(29'500)), 300 / 29.5));
+        }
+    }
+    ASSERT(is_equal(statistics.GetQps(start + std::chrono::milliseconds(89'500)), 10.0));
+    // a quiet minute later nothing is left in the window
+    ASSERT(is_equal(statistics.GetQps(start + std::chrono::seconds(200)), 0.0));
+    ASSERT_EQUAL(statistics.GetRequestCount(), 900u);
+    ASSERT_EQUAL(statistics.GetResultCountFrequency(0), 90u);
+    ASSERT_EQUAL(statistics.GetResultCountFrequency(RequestStatistics::RESULT_COUNT_BUCKETS - 1), 270u);
+    ASSERT_EQUAL(statistics.GetLatency().GetValueAtQuantile(0.5), 98'304u);
+    ASSERT_EQUAL(statistics.GetLatency().GetMax(), 900'000u);
+    ASSERT(statistics.GetQpsWindow() == RequestStatistics::DEFAULT_QPS_WINDOW);
+
+    // a 6 s window counts in steps of 100 ms: a request every step for 6 s, then silence
+    RequestStatistics short_window(std::chrono::seconds(6));
+    ASSERT(short_window.GetQpsWindow() == std::chrono::seconds(6));
+    for (int step = 0; step < 60; ++step) {
+        short_window.Record(start + std::chrono::milliseconds(100 * step), std::chrono::microseconds(1), 1);
+    }
+    ASSERT(is_equal(short_window.GetQps(start + std::chrono::milliseconds(5'950)), 60 / 5.95));
+    // the first half has left the window
+    ASSERT(is_equal(short_window.GetQps(start + std::chrono::milliseconds(8'950)), 5.0));
+    ASSERT(is_equal(short_window.GetQps(start + std::chrono::milliseconds(11'950)), 0.0));
+    try {
+        RequestStatistics too_short(std::chrono::nanoseconds(10));
+        ASSERT_HINT(false, "a window shorter than its steps must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // the queue measures throughput over its own window
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    const RequestQueue queue(server, RequestQueue::DEFAULT_CACHE_CAPACITY, std::chrono::seconds(6));
+    ASSERT(queue.GetStatistics().GetQpsWindow() == std::chrono::seconds(6));
+    const AsyncRequestQueue async_queue(server, 1, AsyncRequestQueue::DEFAULT_QUEUE_CAPACITY,
+        AsyncRequestQueue::Backpressure::BLOCK, std::chrono::seconds(6));
+    ASSERT(async_queue.GetStatistics().GetQpsWindow() == std::chrono::seconds(6));
+
+    std::ostringstream json;
+    statistics.PrintJson(json, start + std::chrono::milliseconds(89'500));
+    ASSERT(IsWellFormedJson(json.str()));
+    ASSERT(json.str().find("\"requests\": 900, \"qps\": 10, "s) != std::string::npos);
+    ASSERT(json.str().find("\"p50\": 98304, "s) != std::string::npos);
+    ASSERT(json.str().find("\"result_counts\": [90, 90, 90, 90, 90, 90, 90, 270]"s) != std::string::npos);
+    std::ostringstream text;
+    statistics.PrintText(text, start + std::chrono::milliseconds(89'500));
+    ASSERT(text.str().find("qps: 10.00\n"s) != std::string::npos);
+}
+
 // The TestSearchServer function is the entry point for running tests
 void TestSearchServer() {
 
@@ -330,4 +1755,28 @@ void TestSearchServer() {
     RUN_TEST(TestGetWordFrequencies);
     RUN_TEST(TestRemoveDocuments);
     RUN_TEST(TestRemoveDuplicates);
-}*/
\ No newline at end of file
+
+    RUN_TEST(TestRequestQueueNoResultRequests);
+    RUN_TEST(TestRequestQueueCache);
+    RUN_TEST(TestAsyncRequests);
+    RUN_TEST(TestQueryArena);
+    RUN_TEST(TestIndexPoolAllocation);
+    RUN_TEST(TestIndexChurn);
+    RUN_TEST(TestBm25Ranking);
+    RUN_TEST(TestStatusAndRatingFilters);
+    RUN_TEST(TestDenseAndSparseScores);
+    RUN_TEST(TestDeterministicRanking);
+    RUN_TEST(TestLazyPaginator);
+    RUN_TEST(TestSearchCursor);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestStopWordFilter);
+    RUN_TEST(TestPatternQueries);
+    RUN_TEST(TestFuzzyQueries);
+    RUN_TEST(TestExternalIndex);
+    RUN_TEST(TestMemoryStats);
+    RUN_TEST(TestOptionalForwardIndex);
+    RUN_TEST(TestIngestDeduplication);
+    RUN_TEST(TestShardDeduplication);
+    RUN_TEST(TestProfiler);
+    RUN_TEST(TestLatencyHistogram);
+}
\ No newline at end of file
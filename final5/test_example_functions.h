@@ -1,5 +1,5 @@
 #pragma once
-/*
+
 #include "search_server.h"
 #include "remove_duplicates.h"
 
@@ -27,6 +27,9 @@ void AssertEqualImpl(const T&, const U&, const std::string&, const std::string&,
 
 bool is_equal(const double l, const double r);
 
+// Same documents in the same order with bitwise equal relevances
+bool IsSameRanking(const std::vector<Document>&, const std::vector<Document>&);
+
 
 SearchServer GetTestServer();
 
@@ -68,6 +71,50 @@ void TestRemoveDocuments();
 
 void TestRemoveDuplicates();
 
+void TestRequestQueueNoResultRequests();
+
+void TestRequestQueueCache();
+
+void TestAsyncRequests();
+
+void TestQueryArena();
+
+void TestIndexPoolAllocation();
+void TestIndexChurn();
+
+void TestBm25Ranking();
+
+void TestStatusAndRatingFilters();
+
+void TestDenseAndSparseScores();
+
+void TestDeterministicRanking();
+
+void TestLazyPaginator();
+
+void TestSearchCursor();
+
+void TestTokenizer();
+
+void TestStopWordFilter();
+
+void TestPatternQueries();
+
+void TestFuzzyQueries();
+
+void TestExternalIndex();
+
+void TestMemoryStats();
+
+void TestOptionalForwardIndex();
+
+void TestIngestDeduplication();
+
+void TestShardDeduplication();
+
+void TestProfiler();
+
+void TestLatencyHistogram();
+
 // The TestSearchServer function is the entry point for running tests
 void TestSearchServer();
-*/
\ No newline at end of file
@@ -0,0 +1,7 @@
+#include "test_example_functions.h"
+
+int main() {
+    TestSearchServer();
+    std::cerr << "All tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t thread_count, size_t queue_capacity, Backpressure backpressure)
+    : tasks_(queue_capacity), backpressure_(backpressure) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] { Work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    tasks_.Close();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::Submit(std::function<void()> task) {
+    if (backpressure_ == Backpressure::REJECT) {
+        return tasks_.TryPush(std::move(task));
+    }
+    return tasks_.Push(std::move(task));
+}
+
+void ThreadPool::Work() {
+    while (std::optional<std::function<void()>> task = tasks_.Pop()) {
+        (*task)();
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+// Fixed set of worker threads draining a bounded queue of tasks
+class ThreadPool {
+public:
+    enum class Backpressure {
+        BLOCK,  // Submit waits for a free slot in the queue
+        REJECT, // Submit returns false when the queue is full
+    };
+
+    ThreadPool(size_t thread_count, size_t queue_capacity, Backpressure backpressure = Backpressure::BLOCK);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs the queued tasks and joins the workers
+    ~ThreadPool();
+
+    // Returns false if the task was rejected
+    bool Submit(std::function<void()> task);
+
+    inline size_t GetThreadCount() const noexcept {
+        return workers_.size();
+    }
+
+private:
+    BoundedQueue<std::function<void()>> tasks_;
+    const Backpressure backpressure_;
+    std::vector<std::thread> workers_;
+
+    void Work();
+};
@@ -0,0 +1,162 @@
+#include "tokenizer.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TOKENIZER_AVX2
+#endif
+
+namespace {
+
+// As SearchServer::IsValidWord: bytes 0x00 - 0x1F; UTF-8 bytes are above 0x7F
+inline bool IsControl(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+inline char FoldAscii(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+constexpr size_t NO_WORD = static_cast<size_t>(-1);
+
+// Byte by byte from position on; word_begin is NO_WORD outside of a word and is carried over calls
+bool ScanBytes(std::string_view text, size_t position, const std::array<bool, 256>& is_delimiter, char* folded,
+    size_t& word_begin, std::pmr::vector<std::string_view>& words) {
+    const char* const base = folded != nullptr ? folded : text.data();
+    for (size_t i = position; i < text.size(); ++i) {
+        const char c = text[i];
+        if (folded != nullptr) {
+            folded[i] = FoldAscii(c);
+        }
+        if (is_delimiter[static_cast<unsigned char>(c)]) {
+            if (word_begin != NO_WORD) {
+                words.emplace_back(base + word_begin, i - word_begin);
+                word_begin = NO_WORD;
+            }
+        }
+        else if (IsControl(c)) {
+            return false;
+        }
+        else if (word_begin == NO_WORD) {
+            word_begin = i;
+        }
+    }
+    if (word_begin != NO_WORD) {
+        words.emplace_back(base + word_begin, text.size() - word_begin);
+    }
+    return true;
+}
+
+} // namespace
+
+Tokenizer::Tokenizer(TokenizerOptions options) : options_(std::move(options)) {
+    if (options_.delimiters.empty()) {
+        throw std::invalid_argument("no delimiters");
+    }
+    for (const char c : options_.delimiters) {
+        if (static_cast<unsigned char>(c) > 0x7F) {
+            throw std::invalid_argument("delimiters must be ASCII");
+        }
+        is_delimiter_[static_cast<unsigned char>(c)] = true;
+    }
+#ifdef TOKENIZER_AVX2
+    use_avx2_ = options_.use_simd && options_.delimiters.size() <= MAX_SIMD_DELIMITERS && __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool Tokenizer::Split(std::string_view text, std::pmr::vector<std::string_view>& words,
+    std::pmr::memory_resource* resource) const {
+    words.clear();
+    char* folded = nullptr;
+    if (options_.fold_case && !text.empty()) {
+        folded = static_cast<char*>(resource->allocate(text.size(), 1));
+    }
+    return use_avx2_ ? SplitAvx2(text, folded, words) : SplitScalar(text, folded, words);
+}
+
+void Tokenizer::FoldCase(std::string& word) const {
+    if (options_.fold_case) {
+        for (char& c : word) {
+            c = FoldAscii(c);
+        }
+    }
+}
+
+bool Tokenizer::SplitScalar(std::string_view text, char* folded, std::pmr::vector<std::string_view>& words) const {
+    size_t word_begin = NO_WORD;
+    return ScanBytes(text, 0, is_delimiter_, folded, word_begin, words);
+}
+
+#ifdef TOKENIZER_AVX2
+
+__attribute__((target("avx2")))
+bool Tokenizer::SplitAvx2(std::string_view text, char* folded, std::pmr::vector<std::string_view>& words) const {
+    constexpr size_t BLOCK = 32;
+    const char* const base = folded != nullptr ? folded : text.data();
+
+    __m256i delimiters[MAX_SIMD_DELIMITERS];
+    const size_t delimiter_count = options_.delimiters.size();
+    for (size_t k = 0; k < delimiter_count; ++k) {
+        delimiters[k] = _mm256_set1_epi8(options_.delimiters[k]);
+    }
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    const __m256i before_a = _mm256_set1_epi8('A' - 1);
+    const __m256i after_z = _mm256_set1_epi8('Z' + 1);
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+
+    size_t word_begin = NO_WORD;
+    size_t i = 0;
+    for (; i + BLOCK <= text.size(); i += BLOCK) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + i));
+
+        __m256i is_delimiter = _mm256_cmpeq_epi8(block, delimiters[0]);
+        for (size_t k = 1; k < delimiter_count; ++k) {
+            is_delimiter = _mm256_or_si256(is_delimiter, _mm256_cmpeq_epi8(block, delimiters[k]));
+        }
+        const uint32_t delimiter_mask = static_cast<uint32_t>(_mm256_movemask_epi8(is_delimiter));
+
+        // signed bytes in [0, 32)
+        const __m256i is_control = _mm256_and_si256(_mm256_cmpgt_epi8(space, block), _mm256_cmpgt_epi8(block, minus_one));
+        if ((static_cast<uint32_t>(_mm256_movemask_epi8(is_control)) & ~delimiter_mask) != 0) {
+            return false;
+        }
+
+        if (folded != nullptr) {
+            const __m256i is_upper = _mm256_and_si256(_mm256_cmpgt_epi8(block, before_a), _mm256_cmpgt_epi8(after_z, block));
+            block = _mm256_or_si256(block, _mm256_and_si256(is_upper, case_bit));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(folded + i), block);
+        }
+
+        // walk the boundaries of the words: the next delimiter inside a word, the next other byte outside
+        const uint64_t delimiter_bits = delimiter_mask;
+        const uint64_t word_bits = ~delimiter_bits & 0xFFFFFFFFu;
+        size_t position = 0;
+        while (position < BLOCK) {
+            const uint64_t bits = (word_begin == NO_WORD ? word_bits : delimiter_bits) >> position;
+            if (bits == 0) {
+                break;
+            }
+            position += __builtin_ctzll(bits);
+            if (word_begin == NO_WORD) {
+                word_begin = i + position;
+            }
+            else {
+                words.emplace_back(base + word_begin, i + position - word_begin);
+                word_begin = NO_WORD;
+            }
+        }
+    }
+
+    return ScanBytes(text, i, is_delimiter_, folded, word_begin, words);
+}
+
+#else
+
+bool Tokenizer::SplitAvx2(std::string_view text, char* folded, std::pmr::vector<std::string_view>& words) const {
+    return SplitScalar(text, folded, words);
+}
+
+#endif
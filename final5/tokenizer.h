@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TokenizerOptions {
+    // ASCII bytes separating words; control characters among them are allowed in the text
+    std::string delimiters = " ";
+    // ASCII letters to lower case; other bytes, UTF-8 sequences included, are kept
+    bool fold_case = false;
+    // false forces the scalar loop, for comparisons
+    bool use_simd = true;
+};
+
+// Splits text into words and rejects control characters in the same pass.
+// Delimiters are ASCII, so UTF-8 sequences are never split.
+// With AVX2 (checked at run time) the text is scanned 32 bytes at a time.
+class Tokenizer {
+public:
+    // The SIMD path compares with every delimiter; longer lists use the table
+    inline static constexpr size_t MAX_SIMD_DELIMITERS = 8;
+
+    explicit Tokenizer(TokenizerOptions options = {});
+
+    // Words are views of text or, with case folding, of a folded copy allocated from resource
+    // and never deallocated: pass an arena or a monotonic resource.
+    // False if text has a control character which is not a delimiter
+    [[nodiscard]] bool Split(std::string_view text, std::pmr::vector<std::string_view>& words,
+        std::pmr::memory_resource* resource) const;
+
+    // Folds the case of a word as Split does
+    void FoldCase(std::string& word) const;
+
+    inline const TokenizerOptions& GetOptions() const noexcept {
+        return options_;
+    }
+
+    inline bool UsesSimd() const noexcept {
+        return use_avx2_;
+    }
+
+private:
+    TokenizerOptions options_;
+    std::array<bool, 256> is_delimiter_{};
+    bool use_avx2_ = false;
+
+    bool SplitScalar(std::string_view text, char* folded, std::pmr::vector<std::string_view>& words) const;
+
+    bool SplitAvx2(std::string_view text, char* folded, std::pmr::vector<std::string_view>& words) const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Forwards to the upstream resource and counts what passes through
+class TrackingResource : public std::pmr::memory_resource {
+    std::pmr::memory_resource* upstream_;
+    uint64_t allocations_ = 0;
+    uint64_t deallocations_ = 0;
+    size_t bytes_in_use_ = 0;
+    size_t peak_bytes_in_use_ = 0;
+
+public:
+    explicit TrackingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+        : upstream_(upstream) {}
+
+    TrackingResource(const TrackingResource&) = delete;
+    TrackingResource& operator=(const TrackingResource&) = delete;
+
+    inline uint64_t GetAllocations() const noexcept {
+        return allocations_;
+    }
+
+    inline uint64_t GetDeallocations() const noexcept {
+        return deallocations_;
+    }
+
+    inline size_t GetBytesInUse() const noexcept {
+        return bytes_in_use_;
+    }
+
+    inline size_t GetPeakBytesInUse() const noexcept {
+        return peak_bytes_in_use_;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* pointer = upstream_->allocate(bytes, alignment);
+        allocations_++;
+        bytes_in_use_ += bytes;
+        if (bytes_in_use_ > peak_bytes_in_use_) {
+            peak_bytes_in_use_ = bytes_in_use_;
+        }
+        return pointer;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        upstream_->deallocate(pointer, bytes, alignment);
+        deallocations_++;
+        bytes_in_use_ -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64-bit hash of a set of words, fed one word at a time in ascending order.
+// Equal sets give equal signatures; unequal sets collide with a chance of about 2^-64,
+// so a match is confirmed against the words before it is trusted.
+class WordSetSignature {
+public:
+    inline void Add(std::string_view word) noexcept {
+        // FNV-1a over the bytes, the length ends the word
+        for (const char c : word) {
+            hash_ = (hash_ ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+        }
+        hash_ = (hash_ ^ word.size()) * FNV_PRIME;
+        ++size_;
+    }
+
+    inline uint64_t Get() const noexcept {
+        // SplitMix64 finalizer, so that the low bits are fit for a hash table
+        uint64_t hash = hash_ ^ size_;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+        return hash ^ (hash >> 31);
+    }
+
+    inline size_t GetSize() const noexcept {
+        return size_;
+    }
+
+private:
+    inline static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+    inline static constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+    uint64_t hash_ = FNV_OFFSET;
+    size_t size_ = 0;
+};
@@ -0,0 +1,116 @@
+#include "zipf_corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_set>
+
+ZipfDistribution::ZipfDistribution(size_t n, double s) : cdf_(n) {
+    double sum = 0.0;
+    for (size_t k = 0; k < n; ++k) {
+        sum += 1.0 / std::pow(static_cast<double>(k + 1), s);
+        cdf_[k] = sum;
+    }
+    for (double& p : cdf_) {
+        p /= sum;
+    }
+}
+
+size_t ZipfDistribution::operator()(std::mt19937_64& generator) const {
+    const double p = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+    const auto it = std::lower_bound(cdf_.begin(), cdf_.end(), p);
+    return std::min(static_cast<size_t>(it - cdf_.begin()), cdf_.size() - 1);
+}
+
+std::vector<std::string> GenerateVocabulary(size_t size, std::mt19937_64& generator) {
+    std::uniform_int_distribution<int> length(3, 10);
+    std::uniform_int_distribution<int> letter('a', 'z');
+
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> vocabulary;
+    vocabulary.reserve(size);
+    while (vocabulary.size() < size) {
+        std::string word(length(generator), ' ');
+        for (char& c : word) {
+            c = static_cast<char>(letter(generator));
+        }
+        if (seen.insert(word).second) {
+            vocabulary.push_back(std::move(word));
+        }
+    }
+    return vocabulary;
+}
+
+Corpus GenerateCorpus(const CorpusOptions& options) {
+    std::mt19937_64 generator(options.seed);
+    const ZipfDistribution zipf(options.vocabulary_size, options.zipf_exponent);
+    std::uniform_int_distribution<size_t> document_length(options.min_words, options.max_words);
+    std::uniform_int_distribution<int> rating(-10, 10);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    Corpus corpus;
+    corpus.vocabulary = GenerateVocabulary(options.vocabulary_size, generator);
+    corpus.stop_words.assign(corpus.vocabulary.begin(),
+        corpus.vocabulary.begin() + std::min(options.stop_word_count, corpus.vocabulary.size()));
+
+    corpus.documents.reserve(options.document_count);
+    corpus.ratings.reserve(options.document_count);
+    for (size_t i = 0; i < options.document_count; ++i) {
+        if (i > 0 && chance(generator) < options.duplicate_ratio) {
+            // same words in another order
+            std::vector<std::string_view> words;
+            std::string_view original = corpus.documents[std::uniform_int_distribution<size_t>(0, i - 1)(generator)];
+            while (!original.empty()) {
+                const size_t space = std::min(original.find(' '), original.size());
+                words.push_back(original.substr(0, space));
+                original.remove_prefix(std::min(space + 1, original.size()));
+            }
+            std::shuffle(words.begin(), words.end(), generator);
+            std::string text;
+            for (const std::string_view word : words) {
+                if (!text.empty()) {
+                    text += ' ';
+                }
+                text += word;
+            }
+            corpus.documents.push_back(std::move(text));
+        }
+        else {
+            std::string text;
+            const size_t length = document_length(generator);
+            for (size_t w = 0; w < length; ++w) {
+                if (w > 0) {
+                    text += ' ';
+                }
+                text += corpus.vocabulary[zipf(generator)];
+            }
+            corpus.documents.push_back(std::move(text));
+        }
+        corpus.ratings.push_back({ rating(generator), rating(generator), rating(generator) });
+    }
+    return corpus;
+}
+
+std::vector<std::string> GenerateQueries(const Corpus& corpus, const CorpusOptions& options, size_t count,
+    size_t plus_words, size_t minus_words, uint64_t seed) {
+    std::mt19937_64 generator(seed);
+    const ZipfDistribution zipf(options.vocabulary_size, options.zipf_exponent);
+    std::uniform_int_distribution<size_t> rare(options.vocabulary_size / 10, options.vocabulary_size - 1);
+
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string query;
+        for (size_t w = 0; w < plus_words; ++w) {
+            query += corpus.vocabulary[zipf(generator)];
+            query += ' ';
+        }
+        for (size_t w = 0; w < minus_words; ++w) {
+            query += '-';
+            query += corpus.vocabulary[rare(generator)];
+            query += ' ';
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
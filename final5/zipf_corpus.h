@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Synthetic corpora for benchmarks: word frequencies follow Zipf's law
+struct CorpusOptions {
+    size_t document_count = 10000;
+    size_t vocabulary_size = 50000;
+    double zipf_exponent = 1.0;
+    size_t min_words = 20;
+    size_t max_words = 80;
+    // share of documents which repeat the words of an earlier one
+    double duplicate_ratio = 0.01;
+    // the most frequent words become stop words
+    size_t stop_word_count = 20;
+    uint64_t seed = 42;
+};
+
+// Samples ranks 0..n-1 with P(k) proportional to 1 / (k + 1)^s
+class ZipfDistribution {
+    std::vector<double> cdf_;
+
+public:
+    ZipfDistribution(size_t n, double s);
+
+    size_t operator()(std::mt19937_64& generator) const;
+};
+
+struct Corpus {
+    // sorted by frequency rank, the most frequent first
+    std::vector<std::string> vocabulary;
+    std::vector<std::string> stop_words;
+    std::vector<std::string> documents;
+    std::vector<std::vector<int>> ratings;
+};
+
+// Distinct random lowercase words of 3 to 10 letters
+std::vector<std::string> GenerateVocabulary(size_t size, std::mt19937_64& generator);
+
+Corpus GenerateCorpus(const CorpusOptions&);
+
+// Queries with plus_words words drawn from the same distribution as the documents
+// and minus_words rare words (minus words are mostly used to exclude niche topics)
+std::vector<std::string> GenerateQueries(const Corpus&, const CorpusOptions&, size_t count,
+    size_t plus_words, size_t minus_words, uint64_t seed);